@@ -0,0 +1,266 @@
+// bench/contention_bench.cpp
+//
+// Multi-thread scaling of the init() pipeline. 1..N threads run the call
+// tree from example.cpp (thread_entry -> top -> middle -> leaf_*) at full
+// speed for a fixed time. Reported per thread count:
+//
+// - aggregate records/s
+// - per-call latency p50/p99/p999 (each log call timed individually)
+// - time spent waiting on the indexed file sink and stderr sink mutexes
+//
+// The sinks are the same types init() uses, with init()'s default
+// rotation and I/O policies, instantiated with a mutex that measures how
+// long lock() blocked.
+//
+//   depthlog_contention_bench [--max-threads=N] [--seconds=1]
+//                             [--sinks=both|file|stderr]
+
+#include "harness.hpp"
+#include "latency.hpp"
+
+#include <depthlog/depthlog.hpp>
+
+// Out-of-line spdlog template members for the instrumented instantiations
+// (not pre-instantiated in the compiled spdlog library).
+#include <spdlog/sinks/ansicolor_sink-inl.h>
+#include <spdlog/sinks/base_sink-inl.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct wait_stats {
+  std::atomic<std::uint64_t> acquisitions{0};
+  std::atomic<std::uint64_t> contended{0};
+  std::atomic<std::uint64_t> wait_ns{0};
+
+  void reset() {
+    acquisitions = 0;
+    contended = 0;
+    wait_ns = 0;
+  }
+};
+
+// std::mutex that accounts for time blocked in lock(). Tag separates sinks.
+template <int Tag> class instrumented_mutex {
+public:
+  static wait_stats &stats() {
+    static wait_stats s;
+    return s;
+  }
+
+  void lock() {
+    stats().acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (m_.try_lock())
+      return;
+    const auto t0 = clock_type::now();
+    m_.lock();
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        clock_type::now() - t0)
+                        .count();
+    stats().contended.fetch_add(1, std::memory_order_relaxed);
+    stats().wait_ns.fetch_add(static_cast<std::uint64_t>(ns),
+                              std::memory_order_relaxed);
+  }
+  bool try_lock() { return m_.try_lock(); }
+  void unlock() { m_.unlock(); }
+
+private:
+  std::mutex m_;
+};
+
+using file_mutex = instrumented_mutex<0>;
+using stderr_mutex = instrumented_mutex<1>;
+
+// ConsoleMutex policy for the stderr sink.
+struct instrumented_console_mutex {
+  using mutex_t = stderr_mutex;
+  static mutex_t &mutex() {
+    static mutex_t m;
+    return m;
+  }
+};
+
+struct worker {
+  depthlog_bench::latency_buckets lat;
+  const std::atomic<bool> *stop = nullptr;
+
+  void log(const char *fn, int line, const char *text, int arg) {
+    const auto t0 = clock_type::now();
+    spdlog::default_logger_raw()->log(
+        spdlog::source_loc{"example.cpp", line, fn}, spdlog::level::info,
+        "{} {}", text, arg);
+    lat.record(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock_type::now() - t0)
+            .count()));
+  }
+
+  void leaf_ok() {
+    DEPTHLOG_SCOPE();
+    log("leaf_ok", 23, "leaf_ok: work done", 0);
+  }
+
+  void leaf_early_return(bool bail) {
+    DEPTHLOG_SCOPE();
+    log("leaf_early_return", 28, "leaf_early_return: entered", 0);
+    if (bail) {
+      log("leaf_early_return", 30, "leaf_early_return: bailing out early", 0);
+      return;
+    }
+    log("leaf_early_return", 33, "leaf_early_return: continuing", 0);
+  }
+
+  void middle(int n) {
+    DEPTHLOG_SCOPE();
+    log("middle", 38, "middle: n=", n);
+    leaf_ok();
+    leaf_early_return(n % 2 == 0);
+    log("middle", 43, "middle: leaving", n);
+  }
+
+  void top() {
+    DEPTHLOG_SCOPE();
+    log("top", 50, "top: enter", 0);
+    for (int i = 0; i < 3; ++i)
+      middle(i);
+    log("top", 54, "top: exit", 0);
+  }
+
+  void thread_entry(int idx) {
+    DEPTHLOG_SCOPE();
+    while (!stop->load(std::memory_order_relaxed)) {
+      log("thread_entry", 60, "thread_entry: idx=", idx);
+      top();
+    }
+  }
+};
+
+void install_pipeline(const std::string &dir, const std::string &which) {
+  const depthlog::options opts;
+  depthlog::config c;
+  if (which != "stderr") {
+    auto file_sink =
+        std::make_shared<depthlog::indexed_file_sink<file_mutex>>(
+            depthlog::make_log_filename(dir + "/contention"), opts.rotation,
+            opts.io);
+    file_sink->set_formatter(
+        spdlog::details::make_unique<depthlog::config_formatter>(
+            depthlog::config_formatter::role::file));
+    c.sinks.push_back(file_sink);
+  }
+  if (which != "file") {
+    auto stderr_sink = std::make_shared<
+        depthlog::stderr_indent_color_sink<instrumented_console_mutex>>(4);
+    stderr_sink->set_formatter(
+        spdlog::details::make_unique<depthlog::config_formatter>(
+            depthlog::config_formatter::role::console));
+    c.sinks.push_back(stderr_sink);
+  }
+  spdlog::set_default_logger(std::make_shared<depthlog::logger>("main"));
+  depthlog::apply_config(std::move(c));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  auto settings = depthlog_bench::parse_args(argc, argv);
+  unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+  double seconds = 1.0;
+  std::string sinks = "both";
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strncmp(argv[i], "--max-threads=", 14))
+      max_threads = static_cast<unsigned>(std::atoi(argv[i] + 14));
+    else if (!std::strncmp(argv[i], "--seconds=", 10))
+      seconds = std::atof(argv[i] + 10);
+    else if (!std::strncmp(argv[i], "--sinks=", 8))
+      sinks = argv[i] + 8;
+  }
+
+  settings.progress = fdopen(dup(STDERR_FILENO), "w");
+  std::freopen("/dev/null", "w", stderr);
+
+  const depthlog_bench::scratch_dir dir("depthlog_contention");
+  install_pipeline(dir.path(), sinks);
+
+  depthlog_bench::runner r(settings);
+  std::vector<unsigned> counts;
+  for (unsigned n = 1; n < max_threads; n *= 2)
+    counts.push_back(n);
+  counts.push_back(max_threads);
+
+  for (unsigned n : counts) {
+    file_mutex::stats().reset();
+    stderr_mutex::stats().reset();
+
+    std::atomic<bool> stop{false};
+    std::vector<worker> workers(n);
+    std::vector<std::thread> threads;
+    const auto t0 = clock_type::now();
+    for (unsigned i = 0; i < n; ++i) {
+      workers[i].stop = &stop;
+      threads.emplace_back([&w = workers[i], i] {
+        w.thread_entry(static_cast<int>(i));
+      });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto &t : threads)
+      t.join();
+    const double wall_ns = static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock_type::now() - t0)
+            .count());
+
+    depthlog_bench::latency_buckets all;
+    for (auto &w : workers)
+      all.merge(w.lat);
+    const double calls =
+        static_cast<double>(std::max<std::uint64_t>(1, all.total));
+    const auto per_call = [&](const wait_stats &s) {
+      return static_cast<double>(s.wait_ns.load()) / calls;
+    };
+
+    depthlog_bench::result res;
+    res.name = "contention_" + sinks;
+    res.iterations = all.total;
+    res.ns_per_op_min = res.ns_per_op_median =
+        wall_ns * static_cast<double>(n) / calls;
+    res.params = {
+        {"threads", n},
+        {"records_per_sec", calls * 1e9 / wall_ns},
+        {"p50_ns", static_cast<double>(all.percentile(0.5))},
+        {"p99_ns", static_cast<double>(all.percentile(0.99))},
+        {"p999_ns", static_cast<double>(all.percentile(0.999))},
+        {"file_mutex_wait_ns_per_call", per_call(file_mutex::stats())},
+        {"file_mutex_contended",
+         static_cast<double>(file_mutex::stats().contended.load())},
+        {"stderr_mutex_wait_ns_per_call", per_call(stderr_mutex::stats())},
+        {"stderr_mutex_contended",
+         static_cast<double>(stderr_mutex::stats().contended.load())},
+    };
+    std::fprintf(settings.progress,
+                 "threads=%-3u %12.0f rec/s  p50=%6llu p99=%8llu p999=%8llu ns"
+                 "  wait/call file=%.0f stderr=%.0f ns\n",
+                 n, calls * 1e9 / wall_ns,
+                 static_cast<unsigned long long>(all.percentile(0.5)),
+                 static_cast<unsigned long long>(all.percentile(0.99)),
+                 static_cast<unsigned long long>(all.percentile(0.999)),
+                 per_call(file_mutex::stats()),
+                 per_call(stderr_mutex::stats()));
+    r.add(std::move(res));
+  }
+
+  spdlog::shutdown();
+  r.print_json(stdout, "depthlog_contention_bench");
+  return 0;
+}
@@ -0,0 +1,222 @@
+// bench/depthlog_bench.cpp
+//
+// Per-call costs of the depthlog pipeline, broken down by depth and message
+// size:
+//
+// - Scope enter/exit
+// - depth_flag (%D) formatting
+// - make_logfmt_formatter() formatting
+// - stderr_indent_color_sink_mt::log
+// - the full init() logger (rotating file sink + stderr sink)
+// - calls below the runtime level and past the depth cap
+// - whole synthetic call trees (workload.hpp), including 10k-deep recursion
+//
+// Human-readable progress goes to the original stderr; sink output to stderr
+// is discarded; the JSON document goes to stdout.
+//
+//   depthlog_bench [--filter=name] [--min-time-ms=200] [--repetitions=5]
+
+#include "harness.hpp"
+#include "workload.hpp"
+
+#include <depthlog/depthlog.hpp>
+
+#include <ctime>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using depthlog_bench::do_not_optimize;
+
+namespace {
+
+const int kDepths[] = {0, 4, 16, 64};
+const std::size_t kMsgSizes[] = {16, 128, 1024};
+
+spdlog::details::log_msg make_msg(const std::string &payload) {
+  return spdlog::details::log_msg(
+      spdlog::source_loc{"bench.cpp", 42, "bench_fn"}, "bench",
+      spdlog::level::info,
+      spdlog::string_view_t(payload.data(), payload.size()));
+}
+
+// Runs fn with the thread's depth set to d, without d live Scope objects.
+template <class Fn> void at_depth(int d, Fn &&fn) {
+  depthlog::context_guard guard(depthlog::context{d, 0, 0});
+  fn();
+}
+
+void bench_scope(depthlog_bench::runner &r) {
+  for (int d : kDepths) {
+    at_depth(d, [&] {
+      r.run("scope_enter_exit", {{"depth", d}}, [](std::uint64_t n) {
+        for (std::uint64_t i = 0; i < n; ++i) {
+          depthlog::Scope s;
+          do_not_optimize(depthlog::g_depth);
+        }
+      });
+    });
+  }
+}
+
+void bench_depth_flag(depthlog_bench::runner &r) {
+  const std::string payload(16, 'x');
+  const auto msg = make_msg(payload);
+  const std::tm tm{};
+  depthlog::depth_flag flag;
+  for (int d : kDepths) {
+    at_depth(d, [&] {
+      r.run("depth_flag_format", {{"depth", d}}, [&](std::uint64_t n) {
+        spdlog::memory_buf_t buf;
+        for (std::uint64_t i = 0; i < n; ++i) {
+          buf.clear();
+          flag.format(msg, tm, buf);
+          do_not_optimize(buf.data());
+        }
+      });
+    });
+  }
+}
+
+void bench_logfmt_formatter(depthlog_bench::runner &r) {
+  auto f = depthlog::make_logfmt_formatter();
+  for (std::size_t size : kMsgSizes) {
+    const std::string payload(size, 'x');
+    const auto msg = make_msg(payload);
+    for (int d : kDepths) {
+      at_depth(d, [&] {
+        r.run("logfmt_format",
+              {{"depth", d}, {"msg_size", static_cast<double>(size)}},
+              [&](std::uint64_t n) {
+                spdlog::memory_buf_t buf;
+                for (std::uint64_t i = 0; i < n; ++i) {
+                  buf.clear();
+                  f->format(msg, buf);
+                  do_not_optimize(buf.data());
+                }
+              });
+      });
+    }
+  }
+}
+
+void bench_stderr_sink(depthlog_bench::runner &r) {
+  depthlog::stderr_indent_color_sink_mt sink(4);
+  sink.set_pattern(depthlog::kStderrPattern);
+  for (std::size_t size : kMsgSizes) {
+    const std::string payload(size, 'x');
+    const auto msg = make_msg(payload);
+    for (int d : kDepths) {
+      at_depth(d, [&] {
+        r.run("stderr_indent_sink_log",
+              {{"depth", d}, {"msg_size", static_cast<double>(size)}},
+              [&](std::uint64_t n) {
+                for (std::uint64_t i = 0; i < n; ++i)
+                  sink.log(msg);
+              });
+      });
+    }
+  }
+}
+
+// ns/op is per tree; records_per_tree converts it to per-record cost.
+void bench_workload(depthlog_bench::runner &r, spdlog::logger *lg) {
+  struct named_shape {
+    const char *name;
+    depthlog_bench::workload_shape shape;
+  };
+  std::vector<named_shape> shapes(3);
+  shapes[0].name = "workload_example_tree"; // defaults ~ example.cpp
+  shapes[1].name = "workload_wide_tree";
+  shapes[1].shape.fan_out_min = 4;
+  shapes[1].shape.fan_out_max = 8;
+  shapes[1].shape.max_depth = 4;
+  shapes[1].shape.descend_rate = 0.5;
+  shapes[1].shape.payload_max = 512;
+  shapes[1].shape.large_payload_rate = 0.01;
+  shapes[2].name = "workload_recursion";
+  shapes[2].shape.max_depth = 0;
+  shapes[2].shape.recursion_depth = 10000;
+
+  const depthlog_bench::logger_log log{lg};
+  for (const auto &s : shapes) {
+    // Average tree size, measured on a dry run of the same sequence.
+    depthlog_bench::workload_generator dry(s.shape, 1);
+    const int kDryTrees = 16;
+    for (int i = 0; i < kDryTrees; ++i)
+      dry.run_tree([](const spdlog::source_loc &, spdlog::level::level_enum,
+                      std::string_view) {});
+    const double records_per_tree =
+        static_cast<double>(dry.stats().records) / kDryTrees;
+
+    depthlog_bench::workload_generator gen(s.shape, 1);
+    r.run(s.name,
+          {{"fan_out_max", s.shape.fan_out_max},
+           {"depth", s.shape.max_depth},
+           {"recursion", s.shape.recursion_depth},
+           {"records_per_tree", records_per_tree}},
+          [&](std::uint64_t n) {
+            for (std::uint64_t i = 0; i < n; ++i)
+              gen.run_tree(log);
+          });
+  }
+}
+
+void bench_full_logger(depthlog_bench::runner &r, const std::string &dir) {
+  depthlog::init(dir + "/bench");
+  auto *lg = spdlog::default_logger_raw();
+  const spdlog::source_loc loc{"bench.cpp", 42, "bench_fn"};
+
+  for (std::size_t size : kMsgSizes) {
+    const std::string payload(size, 'x');
+    for (int d : kDepths) {
+      at_depth(d, [&] {
+        r.run("init_logger_info",
+              {{"depth", d}, {"msg_size", static_cast<double>(size)}},
+              [&](std::uint64_t n) {
+                for (std::uint64_t i = 0; i < n; ++i)
+                  lg->log(loc, spdlog::level::info, payload);
+              });
+      });
+    }
+  }
+
+  // Disabled paths: below the runtime level, and past the depth cap.
+  const std::string payload(128, 'x');
+  r.run("disabled_runtime_level", {}, [&](std::uint64_t n) {
+    for (std::uint64_t i = 0; i < n; ++i)
+      lg->log(loc, spdlog::level::debug, payload);
+  });
+  depthlog::set_max_depth(spdlog::level::info, 2);
+  at_depth(8, [&] {
+    r.run("disabled_depth_cap", {{"depth", 8}}, [&](std::uint64_t n) {
+      for (std::uint64_t i = 0; i < n; ++i)
+        DEPTHLOG_INFO("{}", payload);
+    });
+  });
+  depthlog::set_max_depth(spdlog::level::info, INT_MAX);
+
+  bench_workload(r, lg);
+  spdlog::shutdown();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  auto settings = depthlog_bench::parse_args(argc, argv);
+
+  // Keep progress on the real stderr; discard what the sinks write there.
+  settings.progress = fdopen(dup(STDERR_FILENO), "w");
+  std::freopen("/dev/null", "w", stderr);
+
+  const depthlog_bench::scratch_dir dir("depthlog_bench");
+
+  depthlog_bench::runner r(settings);
+  bench_scope(r);
+  bench_depth_flag(r);
+  bench_logfmt_formatter(r);
+  bench_stderr_sink(r);
+  bench_full_logger(r, dir.path());
+  r.print_json(stdout, "depthlog_bench");
+  return 0;
+}
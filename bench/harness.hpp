@@ -0,0 +1,179 @@
+#pragma once
+
+// bench/harness.hpp
+//
+// Self-contained micro-benchmark harness for depthlog_bench and friends:
+// calibrates an iteration count to a minimum run time, repeats, and keeps
+// min/median ns per op. Results are printed as one JSON document.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace depthlog_bench {
+
+template <class T> inline void do_not_optimize(const T &v) {
+  asm volatile("" : : "r,m"(v) : "memory");
+}
+
+struct result {
+  std::string name;
+  // Free-form numeric parameters, e.g. {"depth", 8}, {"msg_size", 128}.
+  std::vector<std::pair<std::string, double>> params;
+  std::uint64_t iterations = 0;
+  double ns_per_op_min = 0;
+  double ns_per_op_median = 0;
+};
+
+struct settings {
+  std::chrono::milliseconds min_time{200};
+  int repetitions = 5;
+  std::string filter; // substring match on the benchmark name
+  std::FILE *progress = stderr; // human-readable lines while running
+};
+
+inline settings parse_args(int argc, char **argv) {
+  settings s;
+  for (int i = 1; i < argc; ++i) {
+    const char *a = argv[i];
+    if (!std::strncmp(a, "--min-time-ms=", 14))
+      s.min_time = std::chrono::milliseconds(std::atoi(a + 14));
+    else if (!std::strncmp(a, "--repetitions=", 14))
+      s.repetitions = std::max(1, std::atoi(a + 14));
+    else if (!std::strncmp(a, "--filter=", 9))
+      s.filter = a + 9;
+  }
+  return s;
+}
+
+class runner {
+public:
+  explicit runner(settings s) : settings_(std::move(s)) {}
+
+  bool enabled(const std::string &name) const {
+    return settings_.filter.empty() ||
+           name.find(settings_.filter) != std::string::npos;
+  }
+
+  // fn(iterations) runs the operation `iterations` times.
+  template <class Fn>
+  void run(const std::string &name,
+           std::vector<std::pair<std::string, double>> params, Fn &&fn) {
+    if (!enabled(name))
+      return;
+    using clock = std::chrono::steady_clock;
+
+    std::uint64_t iters = 1;
+    for (;;) {
+      const auto t0 = clock::now();
+      fn(iters);
+      const auto dt = clock::now() - t0;
+      if (dt >= settings_.min_time || iters >= (std::uint64_t{1} << 40))
+        break;
+      const double ratio =
+          static_cast<double>(settings_.min_time.count()) * 1e6 /
+          std::max<double>(1.0, static_cast<double>(
+                                    std::chrono::duration_cast<
+                                        std::chrono::nanoseconds>(dt)
+                                        .count()));
+      iters = static_cast<std::uint64_t>(
+          static_cast<double>(iters) * std::min(10.0, ratio * 1.2) + 1);
+    }
+
+    std::vector<double> samples;
+    for (int r = 0; r < settings_.repetitions; ++r) {
+      const auto t0 = clock::now();
+      fn(iters);
+      const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          clock::now() - t0)
+                          .count();
+      samples.push_back(static_cast<double>(ns) /
+                        static_cast<double>(iters));
+    }
+    std::sort(samples.begin(), samples.end());
+
+    result res;
+    res.name = name;
+    res.params = std::move(params);
+    res.iterations = iters;
+    res.ns_per_op_min = samples.front();
+    res.ns_per_op_median = samples[samples.size() / 2];
+    if (settings_.progress)
+      std::fprintf(settings_.progress, "%-48s %10.1f ns/op\n",
+                   describe_(name, res.params).c_str(), res.ns_per_op_median);
+    results_.push_back(std::move(res));
+  }
+
+  void add(result r) { results_.push_back(std::move(r)); }
+
+  void print_json(std::FILE *out, const char *suite) const {
+    std::fprintf(out, "{\n  \"suite\": \"%s\",\n  \"results\": [", suite);
+    for (std::size_t i = 0; i < results_.size(); ++i) {
+      const auto &r = results_[i];
+      std::fprintf(out, "%s\n    {\"name\": \"%s\"", i ? "," : "",
+                   r.name.c_str());
+      for (const auto &p : r.params)
+        std::fprintf(out, ", \"%s\": %g", p.first.c_str(), p.second);
+      std::fprintf(out,
+                   ", \"iterations\": %llu, \"ns_per_op_min\": %.2f, "
+                   "\"ns_per_op_median\": %.2f}",
+                   static_cast<unsigned long long>(r.iterations),
+                   r.ns_per_op_min, r.ns_per_op_median);
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+  }
+
+private:
+  static std::string
+  describe_(const std::string &name,
+            const std::vector<std::pair<std::string, double>> &params) {
+    std::string s = name;
+    for (const auto &p : params)
+      s += " " + p.first + "=" +
+           std::to_string(static_cast<long long>(p.second));
+    return s;
+  }
+
+  settings settings_;
+  std::vector<result> results_;
+};
+
+// mkdtemp() directory for log files, removed (one level deep) on scope
+// exit. Falls back to "." if it cannot be created.
+class scratch_dir {
+public:
+  explicit scratch_dir(const std::string &prefix) {
+    std::string tmpl = "/tmp/" + prefix + ".XXXXXX";
+    path_ = mkdtemp(tmpl.data()) ? tmpl : ".";
+  }
+  scratch_dir(const scratch_dir &) = delete;
+  scratch_dir &operator=(const scratch_dir &) = delete;
+  ~scratch_dir() {
+    if (path_ == ".")
+      return;
+    if (DIR *d = opendir(path_.c_str())) {
+      while (dirent *e = readdir(d)) {
+        const std::string name = e->d_name;
+        if (name != "." && name != "..")
+          unlink((path_ + "/" + name).c_str());
+      }
+      closedir(d);
+    }
+    rmdir(path_.c_str());
+  }
+
+  const std::string &path() const { return path_; }
+
+private:
+  std::string path_;
+};
+
+} // namespace depthlog_bench
@@ -0,0 +1,45 @@
+#pragma once
+
+// bench/latency.hpp
+//
+// Single-threaded latency histogram for bench drivers: one per worker
+// thread, merged after the run. Same log-linear buckets as
+// depthlog::latency_site, without the atomics and shards.
+
+#include <depthlog/histogram.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace depthlog_bench {
+
+struct latency_buckets {
+  std::vector<std::uint64_t> counts =
+      std::vector<std::uint64_t>(depthlog::latency_site::kBuckets, 0);
+  std::uint64_t total = 0;
+
+  void record(std::uint64_t ns) {
+    ++counts[depthlog::latency_site::bucket_index(ns)];
+    ++total;
+  }
+  void merge(const latency_buckets &o) {
+    for (std::size_t i = 0; i < counts.size(); ++i)
+      counts[i] += o.counts[i];
+    total += o.total;
+  }
+  std::uint64_t percentile(double q) const {
+    const auto rank =
+        std::max<std::uint64_t>(1, static_cast<std::uint64_t>(
+                                       q * static_cast<double>(total)));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+      seen += counts[i];
+      if (seen >= rank)
+        return depthlog::latency_site::bucket_upper(i);
+    }
+    return 0;
+  }
+};
+
+} // namespace depthlog_bench
@@ -0,0 +1,344 @@
+// bench/replay.cpp
+//
+// Replays a captured depthlog logfmt file (e.g. app.log) through a live
+// depthlog pipeline. Every record keeps its tid (one replay thread per
+// recorded tid), level, depth, span ids, file/line/func and message, so the
+// sinks see the production shape: bursts, deep trees, variable payloads.
+//
+//   depthlog_replay <file.log> [--timing=fast|recorded] [--speed=1.0]
+//                   [--loops=1] [--dedup] [--shard] [--config=<file>]
+//                   [--out=<dir>]
+//
+// --timing=recorded sleeps to reproduce the recorded inter-arrival times
+// (divided by --speed); fast replays back to back. --config applies a
+// reload_config_file() file after init(); --out keeps the replayed log
+// files instead of writing them to a temporary directory.
+//
+// Progress goes to the original stderr, sink output to stderr is discarded,
+// and a JSON document is printed to stdout.
+
+#include "harness.hpp"
+#include "latency.hpp"
+
+#include <depthlog/depthlog.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct record {
+  std::int64_t ts_ns = 0; // since the epoch, UTC
+  spdlog::level::level_enum level = spdlog::level::info;
+  depthlog::context ctx;
+  spdlog::source_loc loc;
+  std::string msg;
+};
+
+struct trace {
+  // Recorded tid -> that thread's records, in file order.
+  std::map<std::uint64_t, std::vector<record>> threads;
+  std::set<std::string> strings; // backing store for source_loc pointers
+  std::size_t records = 0;
+  std::size_t skipped = 0;
+  std::int64_t first_ts = INT64_MAX;
+  std::int64_t last_ts = INT64_MIN;
+};
+
+// Days since 1970-01-01 for a proleptic Gregorian date.
+std::int64_t days_from_civil(std::int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+}
+
+// "2026-01-05T13:45:42.095+09:00" -> ns since the epoch (UTC).
+bool parse_ts(std::string_view v, std::int64_t &out) {
+  int y, mo, d, h, mi, s, ms, oh = 0, om = 0;
+  char sign = '+';
+  const std::string str(v);
+  const int n = std::sscanf(str.c_str(), "%d-%d-%dT%d:%d:%d.%d%c%d:%d", &y,
+                            &mo, &d, &h, &mi, &s, &ms, &sign, &oh, &om);
+  if (n < 7)
+    return false;
+  std::int64_t secs = days_from_civil(y, static_cast<unsigned>(mo),
+                                      static_cast<unsigned>(d)) *
+                          86400 +
+                      h * 3600 + mi * 60 + s;
+  if (n >= 9)
+    secs -= (sign == '-' ? -1 : 1) * (oh * 3600 + om * 60);
+  out = secs * 1000000000 + static_cast<std::int64_t>(ms) * 1000000;
+  return true;
+}
+
+// Splits one logfmt line into key/value pairs. Values are bare or quoted;
+// msg is always last and taken verbatim up to the closing quote, since the
+// pattern does not escape it.
+template <class F> void for_each_field(std::string_view line, F &&f) {
+  std::size_t i = 0;
+  while (i < line.size()) {
+    while (i < line.size() && line[i] == ' ')
+      ++i;
+    const auto eq = line.find('=', i);
+    if (eq == std::string_view::npos)
+      return;
+    const auto key = line.substr(i, eq - i);
+    i = eq + 1;
+    std::string_view value;
+    if (i < line.size() && line[i] == '"') {
+      std::size_t end;
+      if (key == "msg") {
+        end = line.rfind('"');
+        if (end <= i)
+          end = line.size();
+      } else {
+        end = line.find('"', i + 1);
+        if (end == std::string_view::npos)
+          end = line.size();
+      }
+      value = line.substr(i + 1, end - i - 1);
+      i = end + 1;
+    } else {
+      const auto end = std::min(line.find(' ', i), line.size());
+      value = line.substr(i, end - i);
+      i = end;
+    }
+    f(key, value);
+  }
+}
+
+const char *intern(trace &t, std::string_view s) {
+  return t.strings.emplace(s).first->c_str();
+}
+
+trace load_trace(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    spdlog::throw_spdlog_ex("depthlog_replay: cannot open " + path, errno);
+  trace t;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (!line.empty() && line[0] == '\0')
+      continue; // padding at the end of a direct-I/O log
+    record r;
+    std::uint64_t tid = 0;
+    bool have_ts = false, have_tid = false, ok = true;
+    for_each_field(line, [&](std::string_view k, std::string_view v) {
+      const std::string s(v);
+      if (k == "ts") {
+        have_ts = parse_ts(v, r.ts_ns);
+      } else if (k == "level") {
+        const auto lvl = spdlog::level::from_str(s);
+        ok = ok && (lvl != spdlog::level::off || s == "off");
+        r.level = lvl;
+      } else if (k == "depth") {
+        r.ctx.depth = std::atoi(s.c_str());
+      } else if (k == "span") {
+        r.ctx.span = std::strtoull(s.c_str(), nullptr, 16);
+      } else if (k == "parent") {
+        r.ctx.parent = std::strtoull(s.c_str(), nullptr, 16);
+      } else if (k == "tid") {
+        tid = std::strtoull(s.c_str(), nullptr, 10);
+        have_tid = true;
+      } else if (k == "file") {
+        r.loc.filename = intern(t, v);
+      } else if (k == "line") {
+        r.loc.line = std::atoi(s.c_str());
+      } else if (k == "func") {
+        r.loc.funcname = intern(t, v);
+      } else if (k == "msg") {
+        r.msg = s;
+      }
+    });
+    if (!ok || !have_ts || !have_tid) {
+      ++t.skipped;
+      continue;
+    }
+    t.first_ts = std::min(t.first_ts, r.ts_ns);
+    t.last_ts = std::max(t.last_ts, r.ts_ns);
+    t.threads[tid].push_back(std::move(r));
+    ++t.records;
+  }
+  return t;
+}
+
+struct replay_settings {
+  bool recorded = false;
+  double speed = 1.0;
+  int loops = 1;
+};
+
+struct replay_stats {
+  depthlog_bench::latency_buckets call; // per-record log() time
+  depthlog_bench::latency_buckets lag;  // behind schedule (recorded only)
+};
+
+void replay_thread(const std::vector<record> &records, const trace &t,
+                   const replay_settings &rs, clock_type::time_point start,
+                   replay_stats &stats) {
+  auto *lg = spdlog::default_logger_raw();
+  for (const record &r : records) {
+    if (rs.recorded) {
+      const auto offset = std::chrono::nanoseconds(static_cast<std::int64_t>(
+          static_cast<double>(r.ts_ns - t.first_ts) / rs.speed));
+      const auto due = start + offset;
+      const auto now = clock_type::now();
+      if (now < due)
+        std::this_thread::sleep_until(due);
+      else
+        stats.lag.record(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - due)
+                .count()));
+    }
+    depthlog::context_guard guard(r.ctx);
+    const auto t0 = clock_type::now();
+    lg->log(r.loc, r.level, r.msg);
+    stats.call.record(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock_type::now() - t0)
+            .count()));
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  auto settings = depthlog_bench::parse_args(argc, argv);
+  replay_settings rs;
+  depthlog::options opts;
+  std::string input, config_path, out_dir;
+  for (int i = 1; i < argc; ++i) {
+    const char *a = argv[i];
+    if (!std::strcmp(a, "--timing=recorded"))
+      rs.recorded = true;
+    else if (!std::strcmp(a, "--timing=fast"))
+      rs.recorded = false;
+    else if (!std::strncmp(a, "--speed=", 8))
+      rs.speed = std::max(1e-6, std::atof(a + 8));
+    else if (!std::strncmp(a, "--loops=", 8))
+      rs.loops = std::max(1, std::atoi(a + 8));
+    else if (!std::strcmp(a, "--dedup"))
+      opts.dedup = true;
+    else if (!std::strcmp(a, "--shard"))
+      opts.shard_per_thread = true;
+    else if (!std::strncmp(a, "--config=", 9))
+      config_path = a + 9;
+    else if (!std::strncmp(a, "--out=", 6))
+      out_dir = a + 6;
+    else if (a[0] != '-')
+      input = a;
+  }
+  if (input.empty()) {
+    std::fprintf(stderr, "usage: %s <file.log> [options]\n", argv[0]);
+    return 2;
+  }
+
+  trace t;
+  try {
+    t = load_trace(input);
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  if (t.records == 0) {
+    std::fprintf(stderr, "depthlog_replay: no records in %s\n",
+                 input.c_str());
+    return 1;
+  }
+
+  settings.progress = fdopen(dup(STDERR_FILENO), "w");
+  std::freopen("/dev/null", "w", stderr);
+
+  std::unique_ptr<depthlog_bench::scratch_dir> scratch;
+  if (out_dir.empty()) {
+    scratch = std::make_unique<depthlog_bench::scratch_dir>("depthlog_replay");
+    out_dir = scratch->path();
+  }
+  depthlog::init(out_dir + "/replay", opts);
+  if (!config_path.empty()) {
+    try {
+      depthlog::reload_config_file(config_path);
+    } catch (const std::exception &e) {
+      std::fprintf(settings.progress, "%s\n", e.what());
+      return 1;
+    }
+  }
+
+  std::vector<replay_stats> stats(t.threads.size());
+  const auto start = clock_type::now();
+  for (int loop = 0; loop < rs.loops; ++loop) {
+    const auto loop_start = clock_type::now();
+    std::vector<std::thread> threads;
+    std::size_t i = 0;
+    for (const auto &kv : t.threads) {
+      threads.emplace_back(replay_thread, std::cref(kv.second), std::cref(t),
+                           std::cref(rs), loop_start, std::ref(stats[i++]));
+    }
+    for (auto &th : threads)
+      th.join();
+  }
+  spdlog::default_logger_raw()->flush();
+  const double wall_ns = static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() -
+                                                           start)
+          .count());
+  spdlog::shutdown();
+
+  depthlog_bench::latency_buckets call, lag;
+  for (const auto &s : stats) {
+    call.merge(s.call);
+    lag.merge(s.lag);
+  }
+  const double records = static_cast<double>(call.total);
+
+  depthlog_bench::result res;
+  res.name = rs.recorded ? "replay_recorded" : "replay_fast";
+  res.iterations = call.total;
+  res.ns_per_op_min = res.ns_per_op_median = wall_ns / records;
+  res.params = {
+      {"threads", static_cast<double>(t.threads.size())},
+      {"records", records},
+      {"skipped_lines", static_cast<double>(t.skipped)},
+      {"recorded_span_ms",
+       static_cast<double>(t.last_ts - t.first_ts) / 1e6},
+      {"wall_ms", wall_ns / 1e6},
+      {"records_per_sec", records * 1e9 / wall_ns},
+      {"p50_ns", static_cast<double>(call.percentile(0.5))},
+      {"p99_ns", static_cast<double>(call.percentile(0.99))},
+      {"p999_ns", static_cast<double>(call.percentile(0.999))},
+  };
+  if (rs.recorded) {
+    res.params.emplace_back("speed", rs.speed);
+    res.params.emplace_back("late_records", static_cast<double>(lag.total));
+    res.params.emplace_back("late_p99_ns",
+                            static_cast<double>(lag.percentile(0.99)));
+  }
+  std::fprintf(settings.progress,
+               "%s: %zu records on %zu threads in %.1f ms (%.0f rec/s), "
+               "p50=%llu p99=%llu ns\n",
+               input.c_str(), t.records, t.threads.size(), wall_ns / 1e6,
+               records * 1e9 / wall_ns,
+               static_cast<unsigned long long>(call.percentile(0.5)),
+               static_cast<unsigned long long>(call.percentile(0.99)));
+
+  depthlog_bench::runner r(settings);
+  r.add(std::move(res));
+  r.print_json(stdout, "depthlog_replay");
+  return 0;
+}
@@ -0,0 +1,95 @@
+// bench/workload.cpp
+//
+// Writes a synthetic depthlog log through init(), for the analyzers and
+// depthlog_replay:
+//
+//   depthlog_workload [--out=workload] [--seed=1] [--stderr]
+//                     [--threads=4] [--trees=100] [--fan-out=1:3]
+//                     [--depth=3] [--descend-rate=1.0] [--recursion=0]
+//                     [--logs=1:2] [--payload=16:128]
+//                     [--large-payload-rate=0] [--large-payload=4096]
+//                     [--early-return=0.25]
+//
+// e.g. a single 10k-deep recursion:
+//
+//   depthlog_workload --depth=0 --recursion=10000 --trees=1
+//
+// DEPTHLOG_CONFIG is applied after init(). Console output is discarded
+// unless --stderr is given; a summary goes to stdout.
+
+#include "workload.hpp"
+
+#include <depthlog/depthlog.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char **argv) {
+  depthlog_bench::workload_shape shape;
+  std::string out = "workload";
+  std::uint64_t seed = 1;
+  bool keep_stderr = false;
+  for (int i = 1; i < argc; ++i) {
+    const char *a = argv[i];
+    if (depthlog_bench::parse_shape_arg(shape, a))
+      continue;
+    if (!std::strncmp(a, "--out=", 6))
+      out = a + 6;
+    else if (!std::strncmp(a, "--seed=", 7))
+      seed = std::strtoull(a + 7, nullptr, 10);
+    else if (!std::strcmp(a, "--stderr"))
+      keep_stderr = true;
+    else {
+      std::fprintf(stderr, "%s: unknown option %s\n", argv[0], a);
+      return 2;
+    }
+  }
+  try {
+    depthlog_bench::validate_shape(shape);
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+    return 2;
+  }
+  if (!keep_stderr)
+    std::freopen("/dev/null", "w", stderr);
+
+  depthlog::init(out);
+  depthlog::reload_config_env();
+
+  std::vector<depthlog_bench::workload_stats> stats(
+      static_cast<std::size_t>(shape.threads));
+  std::vector<std::thread> threads;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int t = 0; t < shape.threads; ++t) {
+    threads.emplace_back([&, t] {
+      depthlog_bench::workload_generator gen(
+          shape, seed + static_cast<std::uint64_t>(t));
+      const depthlog_bench::logger_log log{spdlog::default_logger_raw()};
+      for (int i = 0; i < shape.trees_per_thread; ++i)
+        gen.run_tree(log);
+      stats[static_cast<std::size_t>(t)] = gen.stats();
+    });
+  }
+  for (auto &th : threads)
+    th.join();
+  const auto ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - t0)
+                      .count();
+  spdlog::shutdown();
+
+  depthlog_bench::workload_stats total;
+  for (const auto &s : stats)
+    total.merge(s);
+  std::printf("threads=%d scopes=%llu records=%llu payload_bytes=%llu "
+              "early_returns=%llu max_depth=%d ms=%.1f\n",
+              shape.threads, static_cast<unsigned long long>(total.scopes),
+              static_cast<unsigned long long>(total.records),
+              static_cast<unsigned long long>(total.payload_bytes),
+              static_cast<unsigned long long>(total.early_returns),
+              total.max_depth, ms);
+  return 0;
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+// bench/workload.hpp
+//
+// Synthetic call-tree workloads: a generalization of example.cpp's
+// top -> middle -> leaf_ok / leaf_early_return shape. Every node is a real
+// depthlog::Scope and logs through a caller-supplied functor, so the same
+// tree can drive depthlog_bench, the analyzers (depthlog_workload writes a
+// log file) or anything else.
+//
+//   depthlog_bench::workload_shape shape;
+//   shape.max_depth = 6;
+//   shape.recursion_depth = 10000;
+//   depthlog_bench::workload_generator gen(shape, /*seed=*/1);
+//   gen.run_tree(depthlog_bench::logger_log{spdlog::default_logger_raw()});
+//
+// Randomness comes from a seeded std::mt19937_64; one generator per thread.
+
+#include <depthlog/depthlog.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace depthlog_bench {
+
+struct workload_shape {
+  // Children per interior node, uniform in [min, max].
+  int fan_out_min = 1;
+  int fan_out_max = 3;
+  // Tree depth below the root; an interior node only has children with
+  // probability descend_rate, so lower values give ragged, shallow trees.
+  int max_depth = 3;
+  double descend_rate = 1.0;
+  // Length of a single self-recursive chain hung off each root (0 = none).
+  int recursion_depth = 0;
+  // Records per scope, uniform in [min, max]. One is logged on entry, the
+  // rest after the children (or skipped on early return).
+  int logs_min = 1;
+  int logs_max = 2;
+  // Message payload bytes, uniform in [min, max]; with probability
+  // large_payload_rate a record carries large_payload bytes instead.
+  std::size_t payload_min = 16;
+  std::size_t payload_max = 128;
+  double large_payload_rate = 0.0;
+  std::size_t large_payload = 4096;
+  // Probability that a scope returns right after its entry record,
+  // skipping its children (warn-level "bailing out early" record).
+  double early_return_rate = 0.25;
+  // Used by drivers that fan trees out over threads.
+  int threads = 1;
+  int trees_per_thread = 1;
+};
+
+struct workload_stats {
+  std::uint64_t scopes = 0;
+  std::uint64_t records = 0;
+  std::uint64_t payload_bytes = 0;
+  std::uint64_t early_returns = 0;
+  int max_depth = 0;
+
+  void merge(const workload_stats &o) {
+    scopes += o.scopes;
+    records += o.records;
+    payload_bytes += o.payload_bytes;
+    early_returns += o.early_returns;
+    max_depth = std::max(max_depth, o.max_depth);
+  }
+};
+
+// Log functor for the default pipeline: what SPDLOG_INFO() and friends do,
+// with the depth cap applied like the DEPTHLOG_* macros.
+struct logger_log {
+  spdlog::logger *lg;
+
+  void operator()(const spdlog::source_loc &loc,
+                  spdlog::level::level_enum lvl,
+                  std::string_view payload) const {
+    if (depthlog::depth_allowed(lvl))
+      lg->log(loc, lvl,
+              spdlog::string_view_t(payload.data(), payload.size()));
+  }
+};
+
+// Throws spdlog::spdlog_ex naming the first field that is out of range:
+// counts must be non-negative, every "min:max" range ordered, rates in
+// [0, 1] and payload sizes representable by the generator.
+inline void validate_shape(const workload_shape &s) {
+  const auto fail = [](const std::string &what) {
+    spdlog::throw_spdlog_ex("workload shape: " + what);
+  };
+  const auto range = [&](const char *name, auto lo, auto hi) {
+    if constexpr (std::is_signed_v<decltype(lo)>)
+      if (lo < 0)
+        fail(std::string(name) + " minimum " + std::to_string(lo) +
+             " is negative");
+    if (lo > hi)
+      fail(std::string(name) + " range " + std::to_string(lo) + ":" +
+           std::to_string(hi) + " has min > max");
+  };
+  const auto non_negative = [&](const char *name, int v) {
+    if (v < 0)
+      fail(std::string(name) + " " + std::to_string(v) + " is negative");
+  };
+  const auto rate = [&](const char *name, double v) {
+    if (!(v >= 0 && v <= 1))
+      fail(std::string(name) + " " + std::to_string(v) +
+           " is not in [0, 1]");
+  };
+  range("fan-out", s.fan_out_min, s.fan_out_max);
+  range("logs", s.logs_min, s.logs_max);
+  range("payload", s.payload_min, s.payload_max);
+  non_negative("depth", s.max_depth);
+  non_negative("recursion", s.recursion_depth);
+  rate("descend-rate", s.descend_rate);
+  rate("large-payload-rate", s.large_payload_rate);
+  rate("early-return", s.early_return_rate);
+  // emit_() draws payload sizes as int.
+  const auto max_payload =
+      static_cast<std::size_t>(std::numeric_limits<int>::max());
+  if (s.payload_max > max_payload || s.large_payload > max_payload)
+    fail("payload sizes are limited to " + std::to_string(max_payload));
+  if (s.threads < 1 || s.trees_per_thread < 1)
+    fail("threads and trees must be at least 1");
+}
+
+class workload_generator {
+public:
+  // Validates the shape first (see validate_shape()), so every payload
+  // size emit_() can draw fits payload_.
+  workload_generator(const workload_shape &shape, std::uint64_t seed)
+      : shape_((validate_shape(shape), shape)), rng_(seed) {
+    const auto biggest = std::max(shape_.payload_max, shape_.large_payload);
+    payload_.reserve(biggest);
+    for (std::size_t i = 0; i < biggest; ++i)
+      payload_.push_back(static_cast<char>('a' + i % 26));
+  }
+
+  // One tree: a root scope, its random subtree and the recursion chain.
+  template <class Log> void run_tree(Log &&log) {
+    depthlog::Scope scope;
+    ++stats_.scopes;
+    note_depth_();
+    emit_(log, loc_("root", __LINE__), spdlog::level::info);
+    if (shape_.max_depth > 0)
+      children_(log, 1);
+    if (shape_.recursion_depth > 0)
+      recurse_(log, shape_.recursion_depth);
+    emit_(log, loc_("root", __LINE__), spdlog::level::info);
+  }
+
+  const workload_stats &stats() const { return stats_; }
+  const workload_shape &shape() const { return shape_; }
+
+private:
+  static spdlog::source_loc loc_(const char *func, int line) {
+    return spdlog::source_loc{"workload.hpp", line, func};
+  }
+
+  template <class Log> void children_(Log &log, int level) {
+    const int n = uniform_(shape_.fan_out_min, shape_.fan_out_max);
+    for (int i = 0; i < n; ++i) {
+      if (level >= shape_.max_depth)
+        leaf_(log);
+      else if (chance_(shape_.descend_rate))
+        node_(log, level);
+      else
+        leaf_(log);
+    }
+  }
+
+  template <class Log> void node_(Log &log, int level) {
+    depthlog::Scope scope;
+    ++stats_.scopes;
+    note_depth_();
+    const int logs = uniform_(shape_.logs_min, shape_.logs_max);
+    emit_(log, loc_("node", __LINE__), spdlog::level::info);
+    if (chance_(shape_.early_return_rate)) {
+      ++stats_.early_returns;
+      emit_(log, loc_("node", __LINE__), spdlog::level::warn);
+      return;
+    }
+    children_(log, level + 1);
+    for (int i = 1; i < logs; ++i)
+      emit_(log, loc_("node", __LINE__), spdlog::level::info);
+  }
+
+  // leaf_ok / leaf_early_return from example.cpp.
+  template <class Log> void leaf_(Log &log) {
+    depthlog::Scope scope;
+    ++stats_.scopes;
+    note_depth_();
+    const int logs = uniform_(shape_.logs_min, shape_.logs_max);
+    if (chance_(shape_.early_return_rate)) {
+      ++stats_.early_returns;
+      emit_(log, loc_("leaf_early_return", __LINE__), spdlog::level::info);
+      emit_(log, loc_("leaf_early_return", __LINE__), spdlog::level::warn);
+      return;
+    }
+    for (int i = 0; i < logs; ++i)
+      emit_(log, loc_("leaf_ok", __LINE__), spdlog::level::info);
+  }
+
+  template <class Log> void recurse_(Log &log, int remaining) {
+    depthlog::Scope scope;
+    ++stats_.scopes;
+    note_depth_();
+    emit_(log, loc_("recurse", __LINE__), spdlog::level::info);
+    if (remaining > 1)
+      recurse_(log, remaining - 1);
+  }
+
+  template <class Log>
+  void emit_(Log &log, const spdlog::source_loc &loc,
+             spdlog::level::level_enum lvl) {
+    std::size_t size;
+    if (shape_.large_payload_rate > 0 && chance_(shape_.large_payload_rate))
+      size = shape_.large_payload;
+    else
+      size = static_cast<std::size_t>(
+          uniform_(static_cast<int>(shape_.payload_min),
+                   static_cast<int>(shape_.payload_max)));
+    ++stats_.records;
+    stats_.payload_bytes += size;
+    log(loc, lvl, std::string_view(payload_.data(), size));
+  }
+
+  void note_depth_() {
+    stats_.max_depth = std::max(stats_.max_depth, depthlog::depth());
+  }
+
+  int uniform_(int lo, int hi) {
+    if (hi <= lo)
+      return lo;
+    return std::uniform_int_distribution<int>(lo, hi)(rng_);
+  }
+
+  bool chance_(double p) {
+    if (p <= 0)
+      return false;
+    if (p >= 1)
+      return true;
+    return std::uniform_real_distribution<double>(0, 1)(rng_) < p;
+  }
+
+  workload_shape shape_;
+  std::mt19937_64 rng_;
+  std::string payload_;
+  workload_stats stats_;
+};
+
+// Applies one --key=value option to a shape; ranges are "min:max" or a
+// single value. Returns false if the option is not a shape option.
+inline bool parse_shape_arg(workload_shape &s, const char *arg) {
+  const auto range = [](const char *v, auto &lo, auto &hi) {
+    using T = std::remove_reference_t<decltype(lo)>;
+    lo = static_cast<T>(std::strtoull(v, nullptr, 10));
+    const char *colon = std::strchr(v, ':');
+    hi = colon ? static_cast<T>(std::strtoull(colon + 1, nullptr, 10)) : lo;
+  };
+  const auto opt = [arg](const char *name) -> const char * {
+    const auto n = std::strlen(name);
+    return std::strncmp(arg, name, n) == 0 ? arg + n : nullptr;
+  };
+  if (auto v = opt("--fan-out="))
+    range(v, s.fan_out_min, s.fan_out_max);
+  else if (auto v = opt("--depth="))
+    s.max_depth = std::atoi(v);
+  else if (auto v = opt("--descend-rate="))
+    s.descend_rate = std::atof(v);
+  else if (auto v = opt("--recursion="))
+    s.recursion_depth = std::atoi(v);
+  else if (auto v = opt("--logs="))
+    range(v, s.logs_min, s.logs_max);
+  else if (auto v = opt("--payload="))
+    range(v, s.payload_min, s.payload_max);
+  else if (auto v = opt("--large-payload-rate="))
+    s.large_payload_rate = std::atof(v);
+  else if (auto v = opt("--large-payload="))
+    s.large_payload = std::strtoull(v, nullptr, 10);
+  else if (auto v = opt("--early-return="))
+    s.early_return_rate = std::atof(v);
+  else if (auto v = opt("--threads="))
+    s.threads = std::max(1, std::atoi(v));
+  else if (auto v = opt("--trees="))
+    s.trees_per_thread = std::max(1, std::atoi(v));
+  else
+    return false;
+  return true;
+}
+
+} // namespace depthlog_bench
@@ -0,0 +1,39 @@
+# check/check_symbols.cmake
+#
+#   cmake -DNM=<nm> -DOBJECTS=<objects> -DEXPECT_SCOPES=<0|1>
+#         -P check_symbols.cmake
+#
+# Fails unless the objects reference depthlog's thread-local scope state
+# (g_depth, g_span, g_parent) exactly when EXPECT_SCOPES is 1: compiled-out
+# scopes must leave no bookkeeping in the object code, and live ones must
+# show up, or the check proves nothing.
+
+foreach(_var NM OBJECTS EXPECT_SCOPES)
+  if(NOT DEFINED ${_var})
+    message(FATAL_ERROR "check_symbols.cmake: ${_var} not set")
+  endif()
+endforeach()
+
+set(_found "")
+foreach(_obj IN LISTS OBJECTS)
+  execute_process(COMMAND "${NM}" -C "${_obj}"
+    OUTPUT_VARIABLE _syms RESULT_VARIABLE _rc)
+  if(NOT _rc EQUAL 0)
+    message(FATAL_ERROR "${NM} failed on ${_obj}")
+  endif()
+  foreach(_tls g_depth g_span g_parent)
+    if(_syms MATCHES "depthlog::${_tls}[^A-Za-z0-9_]")
+      list(APPEND _found "${_tls}")
+    endif()
+  endforeach()
+endforeach()
+list(REMOVE_DUPLICATES _found)
+
+if(EXPECT_SCOPES AND NOT _found)
+  message(FATAL_ERROR
+    "live DEPTHLOG_SCOPE() left no depthlog TLS reference in ${OBJECTS}")
+elseif(NOT EXPECT_SCOPES AND _found)
+  message(FATAL_ERROR
+    "compiled-out DEPTHLOG_SCOPE() still references depthlog::{${_found}}")
+endif()
+message(STATUS "scope TLS references: ${_found}")
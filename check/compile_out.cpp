@@ -0,0 +1,39 @@
+// check/compile_out.cpp
+//
+// Built once per level pair by CMakeLists.txt. EXPECT_SCOPES says whether
+// DEPTHLOG_SCOPE() must keep its depth bookkeeping (1) or expand to
+// nothing (0) under this SPDLOG_ACTIVE_LEVEL / DEPTHLOG_SCOPE_MIN_LEVEL.
+// The expansion is checked when compiling, the depth inside the probe's
+// scopes when running, and the probe's object code by check_symbols.cmake.
+
+#include <depthlog/depthlog.hpp>
+
+#include <cstdio>
+#include <string_view>
+
+#define CHECK_STR_(x) #x
+#define CHECK_STR(x) CHECK_STR_(x)
+
+constexpr std::string_view kExpansion = CHECK_STR(DEPTHLOG_SCOPE());
+constexpr bool kCompiledOut = kExpansion == "static_cast<void>(0)";
+static_assert(kCompiledOut == !EXPECT_SCOPES,
+              "DEPTHLOG_SCOPE() expansion does not match the levels");
+
+// scope_probe.cpp: two DEPTHLOG_SCOPE()s around inside().
+void scope_probe(void (*inside)());
+
+static int inside = -1;
+
+int main() {
+  scope_probe([] { inside = depthlog::depth(); });
+  const int want = EXPECT_SCOPES ? 2 : 0;
+  std::printf("SPDLOG_ACTIVE_LEVEL=%d DEPTHLOG_SCOPE_MIN_LEVEL=%d: "
+              "DEPTHLOG_SCOPE() -> %s, depth %d\n",
+              SPDLOG_ACTIVE_LEVEL, DEPTHLOG_SCOPE_MIN_LEVEL,
+              CHECK_STR(DEPTHLOG_SCOPE()), inside);
+  if (inside != want || depthlog::depth() != 0) {
+    std::fprintf(stderr, "expected depth %d\n", want);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,41 @@
+// check/config_cap.cpp
+//
+// A depth cap set with set_max_depth() before init() must still be in
+// force afterwards: in the atomics DEPTHLOG_<LEVEL>() reads and in the
+// snapshot later reloads start from.
+
+#include <depthlog/depthlog.hpp>
+
+#include <cstdio>
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    std::fprintf(stderr, "config_cap: %s\n", what);
+    ++failures;
+  }
+}
+
+int main() {
+  depthlog::set_max_depth(spdlog::level::info, 1);
+  depthlog::init("config_cap");
+
+  expect(depthlog::max_depth(spdlog::level::info) == 1,
+         "cap dropped from the atomics by init()");
+  expect(depthlog::current_config().max_depth[spdlog::level::info] == 1,
+         "cap missing from init()'s snapshot");
+  expect(depthlog::max_depth(spdlog::level::warn) == INT_MAX,
+         "other levels capped");
+  {
+    depthlog::Scope outer;
+    expect(depthlog::depth_allowed(spdlog::level::info),
+           "depth 1 rejected");
+    depthlog::Scope inner;
+    expect(!depthlog::depth_allowed(spdlog::level::info),
+           "depth 2 allowed");
+  }
+
+  spdlog::shutdown();
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+// check/scope_probe.cpp
+//
+// Nothing but DEPTHLOG_SCOPE()s, in an object file of its own: when they
+// are compiled out it must not reference depthlog's thread-local depth or
+// span state at all (check_symbols.cmake runs nm over it).
+
+#include <depthlog/depthlog.hpp>
+
+void scope_probe(void (*inside)()) {
+  DEPTHLOG_SCOPE();
+  DEPTHLOG_SCOPE();
+  inside();
+}
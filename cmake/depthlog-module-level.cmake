@@ -0,0 +1,37 @@
+# depthlog_set_module_level(<target>... <level>)
+#
+# Overrides the compile-time log floor (SPDLOG_ACTIVE_LEVEL) for the given
+# targets, e.g. to compile trace/debug out of a chatty subsystem while the
+# one under investigation keeps them:
+#
+#   depthlog_set_module_level(net_core storage_io info)
+#   depthlog_set_module_level(scheduler trace)
+#
+# <level> is one of trace, debug, info, warn, error, critical, off. The
+# depthlog INTERFACE target reads the DEPTHLOG_ACTIVE_LEVEL property of each
+# consumer; DEPTHLOG_ENABLE=OFF still forces every target to OFF.
+function(depthlog_set_module_level)
+  if(ARGC LESS 2)
+    message(FATAL_ERROR "depthlog_set_module_level(<target>... <level>)")
+  endif()
+
+  math(EXPR _last "${ARGC} - 1")
+  list(GET ARGV ${_last} _level)
+  list(REMOVE_AT ARGV ${_last})
+
+  string(TOUPPER "${_level}" _level)
+  if(_level STREQUAL "WARNING")
+    set(_level WARN)
+  endif()
+  set(_known TRACE DEBUG INFO WARN ERROR CRITICAL OFF)
+  if(NOT _level IN_LIST _known)
+    message(FATAL_ERROR "depthlog_set_module_level: unknown level '${_level}'")
+  endif()
+
+  foreach(_target IN LISTS ARGV)
+    if(NOT TARGET ${_target})
+      message(FATAL_ERROR "depthlog_set_module_level: no target '${_target}'")
+    endif()
+    set_property(TARGET ${_target} PROPERTY DEPTHLOG_ACTIVE_LEVEL ${_level})
+  endforeach()
+endfunction()
@@ -9,6 +9,9 @@ Assumptions:
 - `depth` is an integer representing current call depth (0 at top-level).
 - `func` is present and is the function name.
 - Logs are in chronological order per thread (interleaving across threads is OK).
+- `span`/`parent` (optional) are hex scope ids; with --graft-spans, work
+  handed to another thread via depthlog::wrap() is attached under the
+  scope that spawned it instead of starting a new tree.
 
 Output:
 - Prints an ASCII tree per thread.
@@ -19,14 +22,50 @@ Usage:
   python3 depthlog_tree.py app.log --show-msg
   python3 depthlog_tree.py app.log --only-tid 3547698
   python3 depthlog_tree.py app.log --max-lines 2000
+  python3 depthlog_tree.py app.log --graft-spans
+  python3 depthlog_tree.py app.log --since 2026-01-05T13:45:42 --until ...
+  python3 depthlog_tree.py app.log --dag
+
+--dag shares structurally identical subtrees: a repeated subtree is printed
+in full once, tagged [#n], and afterwards as [= #n]; a summary of the most
+repeated shapes follows the trees.
+
+If "<logfile>.idx" (written by depthlog::indexed_file_sink) exists,
+--only-tid/--since/--until read only the blocks that can match instead of
+the whole file; --no-index disables this.
+
+Live tail:
+  python3 depthlog_tree.py app.log --follow [--window 20] [--from-end]
+
+keeps reading as the file grows (inotify, or polling where inotify is not
+available), across rotation and truncation, and redraws the trees every
+--refresh seconds. Only the open scopes of each thread are kept, plus the
+last --window closed subtrees under every node and the --max-threads most
+recently active threads, so memory stays flat however long it runs.
+
+Logs written with depthlog::io_policy::direct can end in up to a block of
+NUL padding while open (or after a crash); it is skipped, and --follow
+reads the block again once it is rewritten.
 """
 
 from __future__ import annotations
 
 import argparse
+import ctypes
+import ctypes.util
+import os
+import pickle
 import re
+import select
+import struct
+import sys
+import tempfile
+import time
+from collections import OrderedDict
 from dataclasses import dataclass, field
-from typing import Dict, List, Optional, Tuple
+from datetime import datetime
+from typing import (Callable, Dict, Iterable, Iterator, List, Optional,
+                    Tuple)
 
 
 KV_RE = re.compile(r"""([A-Za-z_][A-Za-z0-9_]*)=("(?:\\.|[^"])*"|[^\s]+)""")
@@ -73,6 +112,127 @@ def parse_logfmt_line(line: str) -> Dict[str, str]:
     return kv
 
 
+# Sidecar index, see include/depthlog/index_format.hpp.
+IDX_MAGIC = b"DLOGIDX1"
+IDX_HEADER = 16
+IDX_ENTRY = struct.Struct("<QQqq4QIiII")
+MASK64 = (1 << 64) - 1
+
+
+@dataclass
+class IndexEntry:
+    offset: int
+    length: int
+    first_ts: int
+    last_ts: int
+    bloom: Tuple[int, int, int, int]
+    records: int
+    max_depth: int
+    level_mask: int
+
+
+def load_index(logfile: str) -> Optional[List[IndexEntry]]:
+    """Entries of <logfile>.idx, or None if missing, foreign or stale."""
+    path = logfile + ".idx"
+    try:
+        with open(path, "rb") as f:
+            data = f.read()
+        size = os.path.getsize(logfile)
+    except OSError:
+        return None
+    if len(data) < IDX_HEADER or data[:8] != IDX_MAGIC:
+        return None
+    (entry_size,) = struct.unpack_from("<I", data, 8)
+    if entry_size != IDX_ENTRY.size:
+        return None
+    entries: List[IndexEntry] = []
+    for pos in range(IDX_HEADER, len(data) - entry_size + 1, entry_size):
+        off, ln, first, last, b0, b1, b2, b3, n, md, lm, _ = \
+            IDX_ENTRY.unpack_from(data, pos)
+        if off + ln > size:
+            return None  # log rotated or truncated under the index
+        entries.append(IndexEntry(off, ln, first, last, (b0, b1, b2, b3),
+                                  n, md, lm))
+    return entries
+
+
+def _tid_bits(tid: int) -> Tuple[int, int]:
+    z = (tid + 0x9E3779B97F4A7C15) & MASK64
+    z = ((z ^ (z >> 30)) * 0xBF58476D1CE4E5B9) & MASK64
+    z = ((z ^ (z >> 27)) * 0x94D049BB133111EB) & MASK64
+    z ^= z >> 31
+    return z & 255, (z >> 8) & 255
+
+
+def bloom_may_contain(e: IndexEntry, tid: int) -> bool:
+    return all(e.bloom[b // 64] >> (b % 64) & 1 for b in _tid_bits(tid))
+
+
+def parse_ts_ns(ts: str) -> Optional[int]:
+    """ISO-8601 timestamp -> UTC ns; naive times are local time."""
+    try:
+        dt = datetime.fromisoformat(ts)
+    except ValueError:
+        return None
+    whole = int(dt.replace(microsecond=0).timestamp())
+    return whole * 1_000_000_000 + dt.microsecond * 1000
+
+
+def iter_log_lines(
+    logfile: str,
+    entries: Optional[List[IndexEntry]],
+    tid: Optional[int],
+    since_ns: Optional[int],
+    until_ns: Optional[int],
+) -> Iterator[str]:
+    """Lines of logfile, skipping indexed blocks that cannot match."""
+    if entries is None:
+        with open(logfile, "r", encoding="utf-8", errors="replace") as f:
+            yield from f
+        return
+
+    def wanted(e: IndexEntry) -> bool:
+        if tid is not None and not bloom_may_contain(e, tid):
+            return False
+        if since_ns is not None and e.last_ts < since_ns:
+            return False
+        # Printed timestamps are truncated (ms by default), so a record can
+        # print at or before until_ns while its exact time is later.
+        if until_ns is not None and \
+                e.first_ts // 1_000_000_000 * 1_000_000_000 > until_ns:
+            return False
+        return True
+
+    def read(f, start: int, end: Optional[int]) -> Iterator[str]:
+        f.seek(start)
+        left = -1 if end is None else end - start
+        carry = b""
+        while left:
+            data = f.read(1 << 20 if left < 0 else min(left, 1 << 20))
+            if not data:
+                break
+            if left > 0:
+                left -= len(data)
+            data = carry + data
+            cut = data.rfind(b"\n") + 1
+            carry = data[cut:]
+            yield from data[:cut].decode(
+                "utf-8", errors="replace").splitlines(True)
+        carry = carry.rstrip(b"\0")  # padding of a direct-I/O log
+        if carry:
+            yield carry.decode("utf-8", errors="replace")
+
+    with open(logfile, "rb") as f:
+        pos = 0
+        for e in entries:
+            if e.offset > pos:  # not covered by the index: scan it
+                yield from read(f, pos, e.offset)
+            if wanted(e):
+                yield from read(f, e.offset, e.offset + e.length)
+            pos = max(pos, e.offset + e.length)
+        yield from read(f, pos, None)  # unindexed tail
+
+
 @dataclass
 class Event:
     ts: str
@@ -83,6 +243,8 @@ class Event:
     file: str = ""
     line: str = ""
     msg: str = ""
+    span: str = ""
+    parent: str = ""
 
 
 @dataclass
@@ -91,6 +253,163 @@ class Node:
     count: int = 1
     children: List["Node"] = field(default_factory=list)
     events: List[Event] = field(default_factory=list)
+    elided: int = 0  # older children dropped by a bounded window
+
+
+@dataclass
+class SpillRun:
+    """Closed sibling subtrees moved out to a SubtreeSpiller's file; stands
+    in for them in Node.children."""
+    offset: int
+    length: int
+
+
+def retire_spans(
+    span_nodes: Optional[Dict[str, Node]],
+    stacks: Dict[str, List[Tuple[int, Node]]],
+    keep: int = 4096,
+) -> set:
+    """ids of the nodes that can still receive children: those on some
+    thread's stack (its own, or one that grafted onto it) and those of the
+    spans remembered for --graft-spans. Only the `keep` most recent spans
+    whose node is on no stack are remembered; work parented to an older
+    one starts a new tree."""
+    pinned = {id(n) for stack in stacks.values() for _, n in stack}
+    if span_nodes is None:
+        return pinned
+    closed = [s for s, n in span_nodes.items() if id(n) not in pinned]
+    for span in closed[:max(0, len(closed) - keep)]:
+        del span_nodes[span]
+    pinned.update(id(n) for n in span_nodes.values())
+    return pinned
+
+
+def open_nodes(roots: Iterable[Node], pinned: set) -> List[Node]:
+    """The roots and every node with a pinned one (see retire_spans) in
+    its subtree, children first. Their other children, except the last
+    (which can still be collapsed into), are closed for good."""
+    top = {id(r) for r in roots}
+    hot: set = set()
+    out: List[Node] = []
+    # Iterative post-order over the in-memory Nodes.
+    work: List[Tuple[Node, bool]] = [(r, False) for r in roots]
+    while work:
+        n, expanded = work.pop()
+        kids = [c for c in n.children if isinstance(c, Node)]
+        if not expanded:
+            work.append((n, True))
+            work.extend((c, False) for c in kids)
+            continue
+        if id(n) in top or id(n) in pinned or \
+                any(id(c) in hot for c in kids):
+            hot.add(id(n))
+            out.append(n)
+    return out
+
+
+class SubtreeSpiller:
+    """Keeps memory bounded on logs of any size: once about `limit` events
+    went into the trees, the closed children of every open node (see
+    open_nodes) are serialized to a temporary file and replaced by
+    SpillRuns. Runs are read back one at a time while rendering.
+
+    A closed depth-0 tree is therefore freed as soon as the next spill
+    comes. With --graft-spans a node stays in memory as long as another
+    thread may still add to it (see retire_spans).
+    """
+
+    def __init__(self, limit: int, directory: Optional[str] = None) -> None:
+        self.limit = limit
+        self.directory = directory
+        self.f = None
+        self.pending = 0
+        self.runs = 0
+
+    def note(self) -> None:
+        self.pending += 1
+
+    def due(self) -> bool:
+        return self.limit > 0 and self.pending >= self.limit
+
+    def spill(
+        self,
+        roots: Dict[str, Node],
+        stacks: Dict[str, List[Tuple[int, Node]]],
+        span_nodes: Optional[Dict[str, Node]] = None,
+    ) -> None:
+        nodes = open_nodes(roots.values(), retire_spans(span_nodes, stacks))
+        keep = {id(n) for n in nodes}
+        for node in nodes:
+            self._spill_children(node, keep)
+        self.pending = 0
+
+    def _spill_children(self, node: Node, keep: set) -> None:
+        # Each run of closed siblings becomes one SpillRun; open children
+        # stay in place between them.
+        kids = node.children
+        out: List = []
+        run: List[Node] = []
+        for c in kids[:-1]:
+            if isinstance(c, Node) and id(c) not in keep:
+                run.append(c)
+                continue
+            if run:
+                out.append(self._write(run))
+                run = []
+            out.append(c)
+        if run:
+            out.append(self._write(run))
+        kids[:-1] = out
+
+    def _write(self, nodes: List[Node]) -> SpillRun:
+        if self.f is None:
+            self.f = tempfile.TemporaryFile(dir=self.directory)
+        blob = pickle.dumps(self._pack(nodes), pickle.HIGHEST_PROTOCOL)
+        self.f.seek(0, os.SEEK_END)
+        run = SpillRun(self.f.tell(), len(blob))
+        self.f.write(blob)
+        self.runs += 1
+        return run
+
+    @staticmethod
+    def _pack(nodes: List) -> list:
+        # Flat preorder, so arbitrarily deep trees do not hit pickle's
+        # recursion limit. Equal labels share one string in the pickle.
+        labels: Dict[str, str] = {}
+        out: list = []
+        work = list(reversed(nodes))
+        while work:
+            n = work.pop()
+            if isinstance(n, SpillRun):
+                out.append(("r", n.offset, n.length))
+                continue
+            out.append(("n", labels.setdefault(n.label, n.label), n.count,
+                        n.elided, len(n.children)))
+            work.extend(reversed(n.children))
+        return out
+
+    def load(self, run: SpillRun) -> List:
+        self.f.seek(run.offset)
+        flat = pickle.loads(self.f.read(run.length))
+        top = Node(label="")
+        # (node, children still to attach)
+        work: List[Tuple[Node, int]] = [(top, -1)]
+        for item in flat:
+            parent, left = work[-1]
+            if item[0] == "r":
+                parent.children.append(SpillRun(item[1], item[2]))
+            else:
+                _, label, count, elided, nkids = item
+                n = Node(label=label, count=count, elided=elided)
+                parent.children.append(n)
+                if nkids:
+                    work[-1] = (parent, left - 1)
+                    work.append((n, nkids))
+                    continue
+            work[-1] = (parent, left - 1)
+            while len(work) > 1 and work[-1][1] == 0:
+                work.pop()
+        return top.children
 
 
 def node_label(ev: Event, show_msg: bool) -> str:
@@ -106,11 +425,23 @@ def add_event_to_tree(
     ev: Event,
     show_msg: bool,
     collapse: bool,
+    span_nodes: Optional[Dict[str, Node]] = None,
+    keep_events: bool = True,
+    max_children: int = 0,
 ) -> None:
     # Pop until parent depth == ev.depth - 1 (or closest available ancestor)
     while stack and stack[-1][0] >= ev.depth:
         stack.pop()
 
+    # Graft: the depth jumps past what this thread has open, but the parent
+    # span is a known node (typically on the thread that spawned the work).
+    if (
+        span_nodes is not None
+        and ev.depth > (stack[-1][0] if stack else -1) + 1
+        and ev.parent in span_nodes
+    ):
+        stack.append((ev.depth - 1, span_nodes[ev.parent]))
+
     # Current depth on stack (virtual root is -1)
     cur_depth = stack[-1][0] if stack else -1
     parent = stack[-1][1] if stack else root
@@ -131,27 +462,475 @@ def add_event_to_tree(
 
     if collapse and parent.children and parent.children[-1].label == lbl:
         parent.children[-1].count += 1
-        parent.children[-1].events.append(ev)
+        if keep_events:
+            parent.children[-1].events.append(ev)
         cur = parent.children[-1]
     else:
-        cur = Node(label=lbl, events=[ev])
+        cur = Node(label=lbl, events=[ev] if keep_events else [])
         parent.children.append(cur)
+        # Only the last child can be open, so the oldest ones are closed
+        # subtrees and safe to drop.
+        if max_children and len(parent.children) > max_children:
+            del parent.children[0]
+            parent.elided += 1
 
+    if span_nodes is not None and ev.span and ev.span != "0":
+        span_nodes[ev.span] = cur
     stack.append((ev.depth, cur))
 
 
-def render_tree(node: Node, prefix: str = "", is_last: bool = True) -> List[str]:
-    lines: List[str] = []
-    # Root is virtual; don't print it
-    for idx, child in enumerate(node.children):
-        last = idx == (len(node.children) - 1)
+def iter_children(
+    node: Node, load: Optional[Callable[[SpillRun], List]] = None
+) -> Iterator[Tuple[Node, bool]]:
+    """(child, is_last) pairs, reading spilled runs back one at a time."""
+    prev: Optional[Node] = None
+    for c in node.children:
+        for x in (load(c) if isinstance(c, SpillRun) else (c,)):
+            if prev is not None:
+                yield prev, False
+            prev = x
+    if prev is not None:
+        yield prev, True
+
+
+def iter_render(
+    node: Node,
+    prefix: str = "",
+    load: Optional[Callable[[SpillRun], List]] = None,
+) -> Iterator[str]:
+    # Root is virtual; don't print it. Iterative, so 10k-deep recursion in
+    # the log does not hit Python's recursion limit; the indentation is one
+    # shared list of segments rather than a prefix string per level.
+    if node.elided:
+        yield prefix + "├── " + f"... {node.elided} earlier"
+    work: List[Iterator[Tuple[Node, bool]]] = [iter_children(node, load)]
+    parts: List[str] = [prefix]
+    while work:
+        nxt = next(work[-1], None)
+        if nxt is None:
+            work.pop()
+            parts.pop()
+            continue
+        child, last = nxt
         branch = "└── " if last else "├── "
         suffix = f"  x{child.count}" if child.count > 1 else ""
-        lines.append(prefix + branch + child.label + suffix)
+        pfx = "".join(parts)
+        yield pfx + branch + child.label + suffix
 
         ext = "    " if last else "│   "
-        lines.extend(render_tree(child, prefix + ext, last))
-    return lines
+        if child.elided:
+            yield pfx + ext + "├── " + f"... {child.elided} earlier"
+        work.append(iter_children(child, load))
+        parts.append(ext)
+
+
+def render_tree(node: Node, prefix: str = "", is_last: bool = True) -> List[str]:
+    return list(iter_render(node, prefix))
+
+
+@dataclass
+class ShapeRef:
+    """`times` consecutive occurrences of an interned subtree; stands in
+    for them in Node.children."""
+    shape: int
+    times: int = 1
+
+
+@dataclass
+class Shape:
+    label: str
+    count: int
+    elided: int
+    children: Tuple[Tuple[int, int], ...]  # (shape, times)
+    size: int  # nodes when fully expanded
+    occurrences: int = 0
+
+
+class ShapeTable:
+    """Hash-consing of closed subtrees (--dag): structurally identical
+    subtrees (same label, count and children, recursively) become one
+    Shape, so memory grows with the number of distinct shapes rather than
+    with the number of records. Like SubtreeSpiller, closed children are
+    interned in batches every `limit` records; only open nodes (see
+    open_nodes) stay plain Nodes."""
+
+    def __init__(self, limit: int) -> None:
+        self.limit = limit
+        self.ids: Dict[tuple, int] = {}
+        self.shapes: List[Shape] = []
+        self.pending = 0
+
+    def note(self) -> None:
+        self.pending += 1
+
+    def due(self) -> bool:
+        return self.limit > 0 and self.pending >= self.limit
+
+    def intern_closed(
+        self,
+        roots: Dict[str, Node],
+        stacks: Dict[str, List[Tuple[int, Node]]],
+        span_nodes: Optional[Dict[str, Node]] = None,
+    ) -> None:
+        nodes = open_nodes(roots.values(), retire_spans(span_nodes, stacks))
+        keep = {id(n) for n in nodes}
+        for node in nodes:
+            self._intern_children(node, len(node.children) - 1, keep)
+        self.pending = 0
+
+    def intern_all(self, roots: Dict[str, Node]) -> None:
+        """At the end of input: nothing is open any more."""
+        for root in roots.values():
+            self._intern_children(root, len(root.children), set())
+
+    def _intern_children(self, node: Node, end: int, keep: set) -> None:
+        # Open children (in `keep`) stay plain Nodes between the refs.
+        out: List = []
+        for c in node.children[:end]:
+            if isinstance(c, Node) and id(c) in keep:
+                out.append(c)
+                continue
+            ref = c if isinstance(c, ShapeRef) else ShapeRef(self._intern(c))
+            if out and isinstance(out[-1], ShapeRef) and \
+                    out[-1].shape == ref.shape:
+                out[-1] = ShapeRef(ref.shape, out[-1].times + ref.times)
+            else:
+                out.append(ref)
+        node.children[:end] = out
+
+    def _intern(self, node: Node) -> int:
+        # Iterative post-order over the plain Nodes; 10k-deep is common.
+        sids: Dict[int, int] = {}
+        work: List[Tuple[Node, bool]] = [(node, False)]
+        while work:
+            n, expanded = work.pop()
+            if not expanded:
+                work.append((n, True))
+                work.extend((c, False) for c in n.children
+                            if isinstance(c, Node))
+                continue
+            kids: List[Tuple[int, int]] = []
+            for c in n.children:
+                ref = (sids.pop(id(c)), 1) if isinstance(c, Node) \
+                    else (c.shape, c.times)
+                if kids and kids[-1][0] == ref[0]:
+                    kids[-1] = (ref[0], kids[-1][1] + ref[1])
+                else:
+                    kids.append(ref)
+            key = (n.label, n.count, n.elided, tuple(kids))
+            sid = self.ids.get(key)
+            if sid is None:
+                sid = len(self.shapes)
+                self.ids[key] = sid
+                size = 1 + sum(self.shapes[k].size * t for k, t in kids)
+                self.shapes.append(Shape(n.label, n.count, n.elided,
+                                         key[3], size))
+            self.shapes[sid].occurrences += 1
+            sids[id(n)] = sid
+        return sids[id(node)]
+
+    def render(self, root: Node, seen: Dict[int, int]) -> Iterator[str]:
+        """Like iter_render, for an interned root. A shape with children
+        that occurs more than once is expanded the first time it is
+        printed, tagged [#n], and later printed as [= #n]; `seen` maps
+        shape -> n across calls."""
+        if root.elided:
+            yield "├── " + f"... {root.elided} earlier"
+        refs = [(c.shape, c.times) for c in root.children]
+        work: List[Tuple[List[Tuple[int, int]], int]] = [(refs, 0)]
+        parts: List[str] = [""]
+        while work:
+            kids, idx = work.pop()
+            if idx >= len(kids):
+                parts.pop()
+                continue
+            work.append((kids, idx + 1))
+            sid, times = kids[idx]
+            sh = self.shapes[sid]
+            last = idx == len(kids) - 1
+            branch = "└── " if last else "├── "
+            mult = sh.count * times
+            suffix = f"  x{mult}" if mult > 1 else ""
+            expand = True
+            if sh.children and sh.occurrences > 1:
+                if sid in seen:
+                    suffix += f"  [= #{seen[sid]}]"
+                    expand = False
+                else:
+                    seen[sid] = len(seen) + 1
+                    suffix += f"  [#{seen[sid]}]"
+            pfx = "".join(parts)
+            yield pfx + branch + sh.label + suffix
+            if not expand:
+                continue
+            ext = "    " if last else "│   "
+            if sh.elided:
+                yield pfx + ext + "├── " + f"... {sh.elided} earlier"
+            work.append((list(sh.children), 0))
+            parts.append(ext)
+
+    def summary(self, seen: Dict[int, int], top: int = 10) -> Iterator[str]:
+        shared = list(seen)
+        yield "\n=== shapes ==="
+        yield (f"{len(self.shapes)} distinct subtrees, "
+               f"{len(shared)} shared; top by nodes saved:")
+        shared.sort(key=lambda sid: -(self.shapes[sid].occurrences - 1)
+                    * self.shapes[sid].size)
+        for sid in shared[:top]:
+            sh = self.shapes[sid]
+            yield (f"  #{seen[sid]}: {sh.occurrences} occurrences, "
+                   f"{sh.size} nodes: {sh.label}")
+
+
+def event_from_line(
+    line: str,
+    only_tid: Optional[str],
+    since_ns: Optional[int],
+    until_ns: Optional[int],
+) -> Optional[Event]:
+    """The record on one log line, or None if it is not a record or is
+    filtered out."""
+    kv = parse_logfmt_line(line)
+    if not kv:
+        return None
+    if "tid" not in kv or "depth" not in kv or "func" not in kv:
+        return None
+
+    tid = kv.get("tid", "")
+    if only_tid and tid != only_tid:
+        return None
+
+    try:
+        depth = int(kv["depth"])
+    except ValueError:
+        return None
+
+    if since_ns is not None or until_ns is not None:
+        ts_ns = parse_ts_ns(kv.get("ts", ""))
+        if ts_ns is None:
+            return None
+        if since_ns is not None and ts_ns < since_ns:
+            return None
+        if until_ns is not None and ts_ns > until_ns:
+            return None
+
+    return Event(
+        ts=kv.get("ts", ""),
+        level=kv.get("level", ""),
+        tid=tid,
+        depth=depth,
+        func=kv.get("func", ""),
+        file=kv.get("file", ""),
+        line=kv.get("line", ""),
+        msg=kv.get("msg", ""),
+        span=kv.get("span", ""),
+        parent=kv.get("parent", ""),
+    )
+
+
+def render_threads(
+    roots: Dict[str, Node],
+    load: Optional[Callable[[SpillRun], List]] = None,
+    shapes: Optional[ShapeTable] = None,
+) -> Iterator[str]:
+    seen: Dict[int, int] = {}
+    for tid in sorted(roots.keys(),
+                      key=lambda x: int(x) if x.isdigit() else x):
+        root = roots[tid]
+        if not root.children:
+            continue  # everything on this thread was grafted elsewhere
+        yield f"\n=== thread tid={tid} ==="
+        if shapes is not None:
+            yield from shapes.render(root, seen)
+        else:
+            yield from iter_render(root, load=load)
+    if shapes is not None:
+        yield from shapes.summary(seen)
+
+
+# inotify(7) constants.
+IN_MODIFY = 0x002
+IN_MOVED_FROM = 0x040
+IN_MOVED_TO = 0x080
+IN_CREATE = 0x100
+IN_DELETE = 0x200
+IN_NONBLOCK = 0o4000
+IN_CLOEXEC = 0o2000000
+
+
+class DirWatch:
+    """Wakes up on changes in one directory: inotify through libc, or plain
+    sleeping where that is not available."""
+
+    def __init__(self, directory: str) -> None:
+        self.fd = -1
+        try:
+            libc = ctypes.CDLL(None, use_errno=True)
+            fd = libc.inotify_init1(IN_NONBLOCK | IN_CLOEXEC)
+        except (OSError, AttributeError):
+            return
+        if fd < 0:
+            return
+        mask = IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+        if libc.inotify_add_watch(fd, os.fsencode(directory), mask) < 0:
+            os.close(fd)
+            return
+        self.fd = fd
+
+    def wait(self, timeout: float) -> None:
+        if self.fd < 0:
+            time.sleep(timeout)
+            return
+        ready, _, _ = select.select([self.fd], [], [], timeout)
+        if ready:
+            try:
+                while os.read(self.fd, 65536):
+                    pass
+            except BlockingIOError:
+                pass
+
+
+class LogTail:
+    """Complete lines appended to a log file. Follows rotation (the path
+    renamed away and recreated: the rest of the old file is read first) and
+    truncation (reads again from the start)."""
+
+    CHUNK = 1 << 20
+
+    def __init__(self, path: str, from_end: bool) -> None:
+        self.path = path
+        self.f = None
+        self.ident: Tuple[int, int] = (0, 0)
+        self.partial = b""
+        self._open(from_end)
+
+    def _open(self, at_end: bool) -> bool:
+        try:
+            f = open(self.path, "rb")
+        except FileNotFoundError:
+            return False
+        st = os.fstat(f.fileno())
+        if at_end:  # before any padding, which gets rewritten
+            end = f.seek(0, os.SEEK_END)
+            f.seek(max(0, end - 4096))
+            tail = f.read()
+            f.seek(end - (len(tail) - len(tail.rstrip(b"\0"))))
+        self.f = f
+        self.ident = (st.st_dev, st.st_ino)
+        self.partial = b""
+        return True
+
+    def _drain(self) -> Iterator[str]:
+        while True:
+            data = self.f.read(self.CHUNK)
+            if not data:
+                return
+            at_end = len(data) < self.CHUNK
+            # NULs at the end are the padded last block of a direct-I/O
+            # log: not written yet, so read them again next time.
+            pad = len(data) - len(data.rstrip(b"\0"))
+            if pad and (at_end or pad < len(data)):
+                self.f.seek(-pad, os.SEEK_CUR)
+                data = data[:-pad]
+            data = self.partial + data
+            cut = data.rfind(b"\n") + 1
+            self.partial = data[cut:]
+            if cut:
+                yield from data[:cut].decode(
+                    "utf-8", errors="replace").splitlines(True)
+            if at_end:
+                return
+
+    def lines(self) -> Iterator[str]:
+        if self.f is None and not self._open(False):
+            return
+        yield from self._drain()
+        try:
+            st = os.stat(self.path)
+        except FileNotFoundError:
+            return  # between the rename and the new file
+        if (st.st_dev, st.st_ino) != self.ident:
+            yield from self._drain()
+            if self.partial:
+                yield self.partial.decode("utf-8", errors="replace")
+            self.f.close()
+            if self._open(False):
+                yield from self._drain()
+        elif st.st_size < self.f.tell():
+            self.f.seek(0)
+            self.partial = b""
+            yield from self._drain()
+
+
+class LiveTrees:
+    """Per-thread trees for --follow, with bounded memory: no events are
+    kept, each node keeps its last `window` children, only the
+    `max_threads` most recently active threads are kept, and at most
+    SPAN_LIMIT spans are remembered for grafting."""
+
+    SPAN_LIMIT = 4096
+
+    def __init__(self, args: argparse.Namespace) -> None:
+        self.args = args
+        self.roots: "OrderedDict[str, Node]" = OrderedDict()
+        self.stacks: Dict[str, List[Tuple[int, Node]]] = {}
+        self.span_nodes: Optional["OrderedDict[str, Node]"] = \
+            OrderedDict() if args.graft_spans else None
+
+    def add(self, ev: Event) -> None:
+        root = self.roots.get(ev.tid)
+        if root is None:
+            root = Node(label=f"tid={ev.tid}")
+            self.roots[ev.tid] = root
+            self.stacks[ev.tid] = []
+            while len(self.roots) > self.args.max_threads:
+                tid, _ = self.roots.popitem(last=False)
+                del self.stacks[tid]
+        else:
+            self.roots.move_to_end(ev.tid)
+
+        add_event_to_tree(
+            root=root,
+            stack=self.stacks[ev.tid],
+            ev=ev,
+            show_msg=self.args.show_msg,
+            collapse=self.args.collapse,
+            span_nodes=self.span_nodes,
+            keep_events=False,
+            max_children=self.args.window,
+        )
+        if self.span_nodes is not None:
+            while len(self.span_nodes) > self.SPAN_LIMIT:
+                self.span_nodes.popitem(last=False)
+
+
+def follow(args: argparse.Namespace, since_ns: Optional[int],
+           until_ns: Optional[int]) -> None:
+    tail = LogTail(args.logfile, args.from_end)
+    watch = DirWatch(os.path.dirname(os.path.abspath(args.logfile)))
+    live = LiveTrees(args)
+    clear = "\x1b[H\x1b[2J" if sys.stdout.isatty() else ""
+    dirty = True
+    drawn = 0.0
+    try:
+        while True:
+            for line in tail.lines():
+                ev = event_from_line(line, args.only_tid, since_ns, until_ns)
+                if ev is not None:
+                    live.add(ev)
+                    dirty = True
+            now = time.monotonic()
+            if dirty and now - drawn >= args.refresh:
+                stamp = time.strftime("%H:%M:%S")
+                out = [f"{clear}# {args.logfile} at {stamp}"]
+                out.extend(render_threads(live.roots))
+                print("\n".join(out), flush=True)
+                dirty = False
+                drawn = now
+            watch.wait(max(0.05, drawn + args.refresh - now) if dirty
+                       else args.refresh)
+    except KeyboardInterrupt:
+        pass
 
 
 def main() -> None:
@@ -170,65 +949,101 @@ def main() -> None:
                     help="do not collapse identical consecutive nodes")
     ap.add_argument("--max-lines", type=int, default=0,
                     help="process at most N lines (0 = all)")
+    ap.add_argument("--graft-spans", action="store_true",
+                    help="attach cross-thread work under its spawning span")
+    ap.add_argument("--since", default=None,
+                    help="only records at or after this ISO-8601 time")
+    ap.add_argument("--until", default=None,
+                    help="only records at or before this ISO-8601 time")
+    ap.add_argument("--no-index", action="store_true",
+                    help="ignore <logfile>.idx and scan the whole file")
+    ap.add_argument("--follow", action="store_true",
+                    help="keep reading as the log grows and redraw")
+    ap.add_argument("--from-end", action="store_true",
+                    help="with --follow, skip what is already in the file")
+    ap.add_argument("--window", type=int, default=20,
+                    help="with --follow, closed subtrees kept per node")
+    ap.add_argument("--max-threads", type=int, default=64,
+                    help="with --follow, most recently active threads kept")
+    ap.add_argument("--refresh", type=float, default=1.0,
+                    help="with --follow, seconds between redraws")
+    ap.add_argument("--spill-every", type=int, default=200_000,
+                    help="move closed subtrees to a temporary file (with "
+                         "--dag: intern them) every N records (0 = never)")
+    ap.add_argument("--dag", action="store_true",
+                    help="share identical subtrees; print repeats as "
+                         "references to their first occurrence")
+    ap.add_argument("--spill-dir", default=None,
+                    help="directory for the spill file (default: $TMPDIR)")
     args = ap.parse_args()
 
+    since_ns = parse_ts_ns(args.since) if args.since else None
+    until_ns = parse_ts_ns(args.until) if args.until else None
+    if (args.since and since_ns is None) or (args.until and until_ns is None):
+        ap.error("--since/--until expect ISO-8601 times")
+    if args.follow:
+        if args.dag:
+            ap.error("--dag cannot be combined with --follow")
+        if args.window < 1 or args.max_threads < 1:
+            ap.error("--window and --max-threads must be at least 1")
+        follow(args, since_ns, until_ns)
+        return
+
+    tid_filter: Optional[int] = None
+    if args.only_tid and args.only_tid.isdigit():
+        tid_filter = int(args.only_tid)
+    filtering = tid_filter is not None or since_ns is not None \
+        or until_ns is not None
+    entries = None
+    if filtering and not args.no_index:
+        entries = load_index(args.logfile)
+
     roots: Dict[str, Node] = {}
     stacks: Dict[str, List[Tuple[int, Node]]] = {}
+    span_nodes: Optional[Dict[str, Node]] = {} if args.graft_spans else None
+    spiller = SubtreeSpiller(args.spill_every, args.spill_dir)
+    shapes = ShapeTable(args.spill_every) if args.dag else None
 
     processed = 0
-    with open(args.logfile, "r", encoding="utf-8", errors="replace") as f:
-        for line in f:
-            if args.max_lines and processed >= args.max_lines:
-                break
-            processed += 1
+    for line in iter_log_lines(args.logfile, entries, tid_filter,
+                               since_ns, until_ns):
+        if args.max_lines and processed >= args.max_lines:
+            break
+        processed += 1
 
-            kv = parse_logfmt_line(line)
-            if not kv:
-                continue
-            if "tid" not in kv or "depth" not in kv or "func" not in kv:
-                continue
+        ev = event_from_line(line, args.only_tid, since_ns, until_ns)
+        if ev is None:
+            continue
 
-            tid = kv.get("tid", "")
-            if args.only_tid and tid != args.only_tid:
-                continue
+        root = roots.get(ev.tid)
+        if root is None:
+            root = Node(label=f"tid={ev.tid}")
+            roots[ev.tid] = root
+            stacks[ev.tid] = []
 
-            try:
-                depth = int(kv["depth"])
-            except ValueError:
-                continue
-
-            ev = Event(
-                ts=kv.get("ts", ""),
-                level=kv.get("level", ""),
-                tid=tid,
-                depth=depth,
-                func=kv.get("func", ""),
-                file=kv.get("file", ""),
-                line=kv.get("line", ""),
-                msg=kv.get("msg", ""),
-            )
-
-            root = roots.get(tid)
-            if root is None:
-                root = Node(label=f"tid={tid}")
-                roots[tid] = root
-                stacks[tid] = []
-
-            add_event_to_tree(
-                root=root,
-                stack=stacks[tid],
-                ev=ev,
-                show_msg=args.show_msg,
-                collapse=args.collapse,
-            )
+        add_event_to_tree(
+            root=root,
+            stack=stacks[ev.tid],
+            ev=ev,
+            show_msg=args.show_msg,
+            collapse=args.collapse,
+            span_nodes=span_nodes,
+            keep_events=False,
+        )
+        if shapes is not None:
+            shapes.note()
+            if shapes.due():
+                shapes.intern_closed(roots, stacks, span_nodes)
+            continue
+        spiller.note()
+        if spiller.due():
+            spiller.spill(roots, stacks, span_nodes)
 
     # Print
-    for tid in sorted(roots.keys(), key=lambda x: int(x) if x.isdigit() else x):
-        root = roots[tid]
-        print(f"\n=== thread tid={tid} ===")
-        # If you want, you can show total events:
-        # total = sum(len(n.events) for n in walk_nodes(root))
-        print("\n".join(render_tree(root)))
+    if shapes is not None:
+        shapes.intern_all(roots)
+    for line in render_threads(roots, spiller.load, shapes):
+        print(line)
 
 
 if __name__ == "__main__":
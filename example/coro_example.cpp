@@ -0,0 +1,144 @@
+// example/coro_example.cpp
+//
+// Demonstrates depthlog/coro.hpp (C++20):
+//
+// - A coroutine keeps its own depth across co_await, even when it is
+//   resumed on another thread.
+// - The thread that resumes it gets its own depth back once the coroutine
+//   suspends again.
+// - Awaiters that do not suspend (suspend_never, a bool await_suspend()
+//   returning false) leave both sides untouched.
+// - Temporary awaiters, like the ones initial_suspend() and final_suspend()
+//   hand to with_context() / final_context(), are still alive when the
+//   coroutine awaits them.
+//
+// Exits non-zero if any of the depths is not the expected one.
+
+#include <depthlog/coro.hpp>
+
+#include <coroutine>
+#include <cstdio>
+#include <exception>
+#include <thread>
+
+namespace {
+
+int failures = 0;
+
+void expect_depth(const char *where, int want) {
+  const int got = depthlog::depth();
+  SPDLOG_INFO("{}: depth {}", where, got);
+  if (got != want) {
+    std::fprintf(stderr, "coro_example: %s: depth %d, expected %d\n", where,
+                 got, want);
+    ++failures;
+  }
+}
+
+// Ready awaiter with state; the destructor clears it, so an awaiter used
+// after the temporary it was made from died reports a bad token.
+struct stateful {
+  static constexpr int kToken = 0x5eed;
+  const char *where;
+  int token = kToken;
+
+  ~stateful() { token = 0; }
+  bool await_ready() const noexcept {
+    check_("await_ready");
+    return true;
+  }
+  void await_suspend(std::coroutine_handle<>) const noexcept {}
+  void await_resume() const noexcept { check_("await_resume"); }
+
+private:
+  void check_(const char *step) const noexcept {
+    if (token != kToken) {
+      std::fprintf(stderr, "coro_example: %s: %s on a dead awaiter\n",
+                   where, step);
+      ++failures;
+    }
+  }
+};
+
+// Fire-and-forget coroutine, started eagerly.
+struct task {
+  struct promise_type : depthlog::coro::promise_mixin {
+    task get_return_object() { return {}; }
+    auto initial_suspend() {
+      return with_context(stateful{"initial_suspend"});
+    }
+    auto final_suspend() noexcept {
+      return final_context(stateful{"final_suspend"});
+    }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+// Parks the coroutine; resume() continues it on the calling thread.
+struct parking {
+  std::coroutine_handle<> waiting;
+
+  auto wait() {
+    struct awaiter {
+      parking &p;
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> h) noexcept {
+        p.waiting = h;
+      }
+      void await_resume() const noexcept {}
+    };
+    return awaiter{*this};
+  }
+
+  void resume() { std::exchange(waiting, {}).resume(); }
+};
+
+// Declines to suspend after looking at the handle.
+struct declined {
+  bool await_ready() const noexcept { return false; }
+  bool await_suspend(std::coroutine_handle<>) const noexcept { return false; }
+  void await_resume() const noexcept {}
+};
+
+task worker(parking &p) {
+  DEPTHLOG_SCOPE();
+  expect_depth("worker: started", 2);
+
+  co_await std::suspend_never{};
+  expect_depth("worker: after suspend_never", 2);
+
+  co_await stateful{"worker"};
+  expect_depth("worker: after stateful", 2);
+
+  co_await declined{};
+  expect_depth("worker: after declined suspension", 2);
+
+  co_await p.wait();
+  expect_depth("worker: resumed on another thread", 2);
+}
+
+} // namespace
+
+int main() {
+  depthlog::init("coro");
+
+  parking p;
+  {
+    DEPTHLOG_SCOPE();
+    worker(p); // runs up to p.wait()
+    expect_depth("main: after worker suspended", 1);
+  }
+  expect_depth("main: after scope", 0);
+
+  std::thread([&p] {
+    DEPTHLOG_SCOPE();
+    DEPTHLOG_SCOPE();
+    DEPTHLOG_SCOPE();
+    p.resume(); // worker finishes here
+    expect_depth("resumer: after worker finished", 3);
+  }).join();
+
+  spdlog::shutdown();
+  return failures == 0 ? 0 : 1;
+}
@@ -7,11 +7,13 @@
 // - depth is printed via spdlog pattern flag %D.
 // - Shows nested calls and early-return paths.
 // - Shows that each thread has independent depth tracking.
+// - Shows depthlog::wrap() carrying the caller's depth into std::async tasks.
 
 #include <depthlog/depthlog.hpp>
 
 #include <spdlog/sinks/basic_file_sink.h>
 
+#include <future>
 #include <thread>
 #include <vector>
 
@@ -77,6 +79,18 @@ int main() {
   for (auto &t : threads)
     t.join();
 
+  // Pool-style hand-off: the task continues the caller's call tree.
+  {
+    DEPTHLOG_SCOPE();
+    SPDLOG_INFO("main: dispatching async task");
+    auto task = std::async(std::launch::async, depthlog::wrap([] {
+                             DEPTHLOG_SCOPE();
+                             SPDLOG_INFO("async task: running");
+                             middle(7);
+                           }));
+    task.get();
+  }
+
   SPDLOG_INFO("main: done");
   return 0;
 }
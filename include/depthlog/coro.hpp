@@ -0,0 +1,153 @@
+#pragma once
+
+// C++20 coroutine support for depthlog.
+//
+// depth/span state is thread_local, so a coroutine that suspends inside a
+// DEPTHLOG_SCOPE() and resumes on another thread would corrupt both threads.
+// promise_mixin keeps that state in the coroutine frame instead: every
+// co_await swaps the frame's state out on suspend and back in on resume,
+// restoring whatever the resuming thread had before.
+//
+//   struct task {
+//     struct promise_type : depthlog::coro::promise_mixin {
+//       auto initial_suspend() { return with_context(std::suspend_always{}); }
+//       auto final_suspend() noexcept {
+//         return final_context(std::suspend_always{});
+//       }
+//       ...
+//     };
+//   };
+
+#include <depthlog/depthlog.hpp>
+
+#if __cplusplus < 202002L || !defined(__cpp_impl_coroutine)
+#error "depthlog/coro.hpp requires C++20 coroutines"
+#endif
+
+#include <coroutine>
+#include <type_traits>
+#include <utility>
+
+namespace depthlog::coro {
+
+// The two states a frame juggles: its own (inner) and the thread's state
+// at the moment it was resumed (outer).
+struct frame_context {
+  context inner = context::capture(); // inherits the creator's position
+  context outer = context::capture();
+};
+
+namespace detail {
+
+inline void install(const context &ctx) noexcept {
+  g_depth = ctx.depth;
+  g_span = ctx.span;
+  g_parent = ctx.parent;
+}
+
+template <class A>
+decltype(auto) get_awaiter(A &&a) {
+  if constexpr (requires { std::forward<A>(a).operator co_await(); })
+    return std::forward<A>(a).operator co_await();
+  else if constexpr (requires { operator co_await(std::forward<A>(a)); })
+    return operator co_await(std::forward<A>(a));
+  else
+    return std::forward<A>(a);
+}
+
+} // namespace detail
+
+// Wraps any awaitable; swaps frame state around its suspension point. At
+// the final suspension point the frame's state is swapped out even if the
+// awaiter does not suspend: the coroutine is done and the thread that
+// resumed it gets its own state back.
+template <class Awaitable> class context_awaiter {
+  // Reference only when an lvalue awaitable is its own awaiter; an rvalue
+  // is moved in, since with_context(std::suspend_always{}) returns the
+  // wrapper from initial_suspend() after the temporary is gone.
+  using get_t = decltype(detail::get_awaiter(std::declval<Awaitable>()));
+  using awaiter_t =
+      std::conditional_t<std::is_lvalue_reference_v<Awaitable>, get_t,
+                         std::remove_cvref_t<get_t>>;
+
+public:
+  context_awaiter(Awaitable &&a, frame_context &frame, bool final = false)
+      : awaiter_(detail::get_awaiter(std::forward<Awaitable>(a))),
+        frame_(frame), final_(final) {}
+
+  // noexcept follows the wrapped awaiter (final_suspend requires it).
+  bool await_ready() noexcept(
+      noexcept(std::declval<awaiter_t &>().await_ready())) {
+    return awaiter_.await_ready();
+  }
+
+  template <class Promise>
+  auto await_suspend(std::coroutine_handle<Promise> h) noexcept(
+      noexcept(std::declval<awaiter_t &>().await_suspend(h))) {
+    // Save before handing the frame to the awaiter: it may be resumed on
+    // another thread before await_suspend() returns, so nothing here may
+    // touch *this once the awaiter has it.
+    frame_.inner = context::capture();
+    detail::install(frame_.outer);
+    swapped_ = true;
+    using result_t = decltype(awaiter_.await_suspend(h));
+    if constexpr (std::is_same_v<result_t, bool>) {
+      const bool suspended = awaiter_.await_suspend(h);
+      if (!suspended) { // resumes right away, on this thread
+        swapped_ = false;
+        detail::install(frame_.inner);
+      }
+      return suspended;
+    } else {
+      return awaiter_.await_suspend(h);
+    }
+  }
+
+  // Swaps back only if await_suspend() did swap: a ready awaiter (or a
+  // bool await_suspend() returning false) never left the coroutine's state.
+  decltype(auto) await_resume() noexcept(
+      noexcept(std::declval<awaiter_t &>().await_resume())) {
+    if (final_) {
+      frame_.inner = context::capture();
+      detail::install(frame_.outer);
+    } else if (swapped_) {
+      swapped_ = false;
+      frame_.outer = context::capture();
+      detail::install(frame_.inner);
+    }
+    return awaiter_.await_resume();
+  }
+
+private:
+  awaiter_t awaiter_;
+  frame_context &frame_;
+  bool final_;
+  bool swapped_ = false;
+};
+
+// Inherit from this in a promise_type. Every co_await in the body is routed
+// through context_awaiter; use with_context() for initial_suspend and
+// final_context() for final_suspend.
+// A promise that needs its own await_transform can call with_context() from
+// it instead.
+class promise_mixin {
+public:
+  template <class A> auto await_transform(A &&a) {
+    return context_awaiter<A>(std::forward<A>(a), frame_);
+  }
+
+  template <class A> auto with_context(A &&a) {
+    return context_awaiter<A>(std::forward<A>(a), frame_);
+  }
+
+  template <class A> auto final_context(A &&a) noexcept {
+    return context_awaiter<A>(std::forward<A>(a), frame_, true);
+  }
+
+  const frame_context &depth_context() const noexcept { return frame_; }
+
+private:
+  frame_context frame_;
+};
+
+} // namespace depthlog::coro
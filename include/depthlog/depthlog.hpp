@@ -4,6 +4,7 @@
 #include "sstream"
 #include <iomanip>
 #include <memory>
+#include <mutex>
 #include <spdlog/details/log_msg.h>
 #include <spdlog/fmt/fmt.h>
 #include <spdlog/pattern_formatter.h>
@@ -12,28 +13,212 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <fcntl.h>
+#include <functional>
+#include <new>
+#include <depthlog/detail/epoch.hpp>
+#include <depthlog/detail/lz4_frame.hpp>
+#include <depthlog/index_format.hpp>
+#include <spawn.h>
 #include <spdlog/details/null_mutex.h>
+#include <spdlog/details/os.h>
+#include <spdlog/details/log_msg_buffer.h>
 #include <spdlog/sinks/base_sink.h>
+#include <spdlog/sinks/dist_sink.h>
 #include <string>
+#include <string_view>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace depthlog {
 
 // thread-local depth state
 inline thread_local int g_depth = 0;
 
+// thread-local id of the innermost open scope (0 = none)
+inline thread_local std::uint64_t g_span = 0;
+// thread-local id of the scope enclosing g_span (0 = none)
+inline thread_local std::uint64_t g_parent = 0;
+
+// Small dense per-process thread index (1, 2, ...), assigned on first use.
+inline std::uint64_t thread_index() {
+  static std::atomic<std::uint64_t> next_thread_index{1};
+  thread_local const std::uint64_t idx =
+      next_thread_index.fetch_add(1, std::memory_order_relaxed);
+  return idx;
+}
+
+// Span ids: thread index in the high 24 bits, per-thread counter below.
+// The thread index is assigned once per thread; after that no atomics.
+inline std::uint64_t next_span_id() {
+  thread_local const std::uint64_t hi = thread_index() << 40;
+  thread_local std::uint64_t counter = 0;
+  return hi | (++counter & ((std::uint64_t{1} << 40) - 1));
+}
+
 struct Scope {
-  Scope() { ++g_depth; }
+  Scope() : prev_span_(g_span), prev_parent_(g_parent) {
+    ++g_depth;
+    g_parent = g_span;
+    g_span = next_span_id();
+  }
   Scope(const Scope &) = delete;
   Scope &operator=(const Scope &) = delete;
   ~Scope() {
     if (g_depth > 0)
       --g_depth;
+    g_span = prev_span_;
+    g_parent = prev_parent_;
   }
+
+private:
+  std::uint64_t prev_span_;
+  std::uint64_t prev_parent_;
+};
+
+// Per-thread record sequence number (%Q), bumped once per record by
+// depthlog::logger. Never decreases on a thread, so (ts, seq) orders a
+// thread's records exactly even when many share a millisecond.
+inline thread_local std::uint64_t g_seq = 0;
+
+// Optional global epoch, mixed into the high 32 bits of seq: a record
+// logged after advance_seq_epoch() (as seen by its thread) has a larger seq
+// than every record logged before it on any thread. Readers pay one relaxed
+// load; nothing on the hot path writes shared memory.
+inline std::atomic<std::uint64_t> g_seq_epoch{0};
+
+inline void advance_seq_epoch() noexcept {
+  g_seq_epoch.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline std::uint64_t next_seq() noexcept {
+  const auto floor = g_seq_epoch.load(std::memory_order_relaxed) << 32;
+  g_seq = std::max(g_seq + 1, floor);
+  return g_seq;
+}
+
+// Background thread that calls advance_seq_epoch() every period, bounding
+// how far apart two threads' seqs can be while still being ordered.
+class seq_epoch_ticker {
+public:
+  explicit seq_epoch_ticker(std::chrono::milliseconds period)
+      : thread_([this, period] { run_(period); }) {}
+  seq_epoch_ticker(const seq_epoch_ticker &) = delete;
+  seq_epoch_ticker &operator=(const seq_epoch_ticker &) = delete;
+  ~seq_epoch_ticker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+private:
+  void run_(std::chrono::milliseconds period) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, period, [this] { return stop_; }))
+      advance_seq_epoch();
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::thread thread_;
 };
 
 inline int depth() { return g_depth; }
 
+// Per-level depth cap: DEPTHLOG_<LEVEL>() drops records whose depth exceeds
+// it before evaluating arguments or formatting. Defaults to unlimited; set
+// with set_max_depth() (below, with the runtime config).
+inline std::atomic<int> g_max_depth[spdlog::level::n_levels] = {
+    INT_MAX, INT_MAX, INT_MAX, INT_MAX, INT_MAX, INT_MAX, INT_MAX};
+
+namespace detail {
+
+inline void store_max_depth(spdlog::level::level_enum lvl, int n) noexcept {
+  g_max_depth[lvl].store(n, std::memory_order_relaxed);
+}
+
+} // namespace detail
+
+inline int max_depth(spdlog::level::level_enum lvl) noexcept {
+  return g_max_depth[lvl].load(std::memory_order_relaxed);
+}
+
+inline bool depth_allowed(spdlog::level::level_enum lvl) noexcept {
+  return g_depth <= g_max_depth[lvl].load(std::memory_order_relaxed);
+}
+
+inline std::uint64_t span_id() { return g_span; }
+inline std::uint64_t parent_span_id() { return g_parent; }
+
+// Snapshot of the calling thread's position in the call tree.
+// Three words; cheap to copy into every task handed to a pool.
+struct context {
+  int depth = 0;
+  std::uint64_t span = 0;   // spawning scope; parent of the task's scopes
+  std::uint64_t parent = 0; // span's own parent
+
+  static context capture() noexcept {
+    return context{g_depth, g_span, g_parent};
+  }
+};
+
+// RAII: install a captured context on the current thread, restore on exit.
+class context_guard {
+public:
+  explicit context_guard(const context &ctx) noexcept
+      : saved_(context::capture()) {
+    g_depth = ctx.depth;
+    g_span = ctx.span;
+    g_parent = ctx.parent;
+  }
+  context_guard(const context_guard &) = delete;
+  context_guard &operator=(const context_guard &) = delete;
+  ~context_guard() {
+    g_depth = saved_.depth;
+    g_span = saved_.span;
+    g_parent = saved_.parent;
+  }
+
+private:
+  context saved_;
+};
+
+// Wrap a callable so it runs under the caller's context, e.g.
+//   pool.submit(depthlog::wrap([] { DEPTHLOG_SCOPE(); ... }));
+//   std::async(std::launch::async, depthlog::wrap(task));
+template <class F> auto wrap(F &&f) {
+  return [ctx = context::capture(),
+          fn = std::decay_t<F>(std::forward<F>(f))](
+             auto &&...args) mutable -> decltype(auto) {
+    context_guard guard(ctx);
+    return fn(std::forward<decltype(args)>(args)...);
+  };
+}
+
 // Custom pattern flag: %D => current thread-local depth
 class depth_flag final : public spdlog::custom_flag_formatter {
 public:
@@ -47,19 +232,70 @@ public:
   }
 };
 
+// Custom pattern flags: %S => current span id, %P => parent span id (hex).
+// These shadow spdlog's seconds/pid flags; use %T for HH:MM:SS instead.
+class span_flag final : public spdlog::custom_flag_formatter {
+public:
+  void format(const spdlog::details::log_msg &, const std::tm &,
+              spdlog::memory_buf_t &dest) override {
+    fmt::format_to(std::back_inserter(dest), "{:x}", g_span);
+  }
+
+  std::unique_ptr<spdlog::custom_flag_formatter> clone() const override {
+    return spdlog::details::make_unique<span_flag>();
+  }
+};
+
+class parent_span_flag final : public spdlog::custom_flag_formatter {
+public:
+  void format(const spdlog::details::log_msg &, const std::tm &,
+              spdlog::memory_buf_t &dest) override {
+    fmt::format_to(std::back_inserter(dest), "{:x}", g_parent);
+  }
+
+  std::unique_ptr<spdlog::custom_flag_formatter> clone() const override {
+    return spdlog::details::make_unique<parent_span_flag>();
+  }
+};
+
+// Custom pattern flag: %Q => record sequence number (see next_seq()).
+// Only depthlog::logger (init()) advances it.
+class seq_flag final : public spdlog::custom_flag_formatter {
+public:
+  void format(const spdlog::details::log_msg &, const std::tm &,
+              spdlog::memory_buf_t &dest) override {
+    fmt::format_to(std::back_inserter(dest), "{}", g_seq);
+  }
+
+  std::unique_ptr<spdlog::custom_flag_formatter> clone() const override {
+    return spdlog::details::make_unique<seq_flag>();
+  }
+};
+
+// Default logfmt-like pattern shared by the file sink and install_depth_flag.
+inline constexpr const char *kLogfmtPattern =
+    R"(ts="%Y-%m-%dT%T.%e%z" level=%l depth=%D span=%S parent=%P tid=%t seq=%Q file="%s" line=%# func="%!" msg="%v")";
+
+// Registers every depthlog flag on a pattern formatter.
+inline void add_depthlog_flags(spdlog::pattern_formatter &f) {
+  f.add_flag<depth_flag>('D');
+  f.add_flag<span_flag>('S');
+  f.add_flag<parent_span_flag>('P');
+  f.add_flag<seq_flag>('Q');
+}
+
 // Installs a formatter globally via spdlog::set_formatter().
 // Pattern emits logfmt-like output.
-inline void install_depth_flag(
-    std::string pattern =
-        R"(ts="%Y-%m-%dT%H:%M:%S.%e%z" level=%l depth=%D tid=%t file="%s" line=%# func="%!" msg="%v")") {
+inline void install_depth_flag(std::string pattern = kLogfmtPattern) {
   auto fmtter = spdlog::details::make_unique<spdlog::pattern_formatter>();
-  fmtter->add_flag<depth_flag>('D');
+  add_depthlog_flags(*fmtter);
   fmtter->set_pattern(std::move(pattern));
   spdlog::set_formatter(std::move(fmtter));
 }
 
 // util
-inline const std::string make_log_filename(const std::string &prefix) {
+// "<prefix>_YYYYmmdd_HHMMSS", the part of a log file name before ".log".
+inline std::string make_log_stem(const std::string &prefix) {
   auto now = std::chrono::system_clock::now();
   std::time_t t = std::chrono::system_clock::to_time_t(now);
 
@@ -67,19 +303,28 @@ inline const std::string make_log_filename(const std::string &prefix) {
   localtime_r(&t, &tm);
 
   std::ostringstream oss;
-  oss << prefix << std::put_time(&tm, "_%Y%m%d_%H%M%S") << ".log";
+  oss << prefix << std::put_time(&tm, "_%Y%m%d_%H%M%S");
   return oss.str();
+}
+
+inline const std::string make_log_filename(const std::string &prefix) {
+  return make_log_stem(prefix) + ".log";
 };
 
 #include <spdlog/common.h> // spdlog::color_mode
 #include <spdlog/pattern_formatter.h>
 #include <spdlog/sinks/base_sink.h>
 
-class stderr_indent_color_sink_mt final
-    : public spdlog::sinks::ansicolor_stderr_sink_mt {
+// ConsoleMutex is spdlog's console mutex policy (console_mutex for _mt,
+// console_nullmutex for _st); benchmarks plug in instrumented ones.
+template <typename ConsoleMutex>
+class stderr_indent_color_sink final
+    : public spdlog::sinks::ansicolor_stderr_sink<ConsoleMutex> {
+  using base = spdlog::sinks::ansicolor_stderr_sink<ConsoleMutex>;
+
 public:
-  explicit stderr_indent_color_sink_mt(std::size_t spaces_per_depth = 4,
-                                       std::string fn_color = "cyan")
+  explicit stderr_indent_color_sink(std::size_t spaces_per_depth = 4,
+                                    std::string fn_color = "cyan")
       : spaces_per_depth_(spaces_per_depth),
         fn_color_code_(std::move(fn_color)) {}
 
@@ -98,7 +343,7 @@ public:
     const bool has_fn = fn.size() > 0;
 
     if (indent == 0 && !has_fn) {
-      spdlog::sinks::ansicolor_stderr_sink_mt::log(msg);
+      base::log(msg);
       return;
     }
 
@@ -123,7 +368,8 @@ public:
     if (has_fn) {
       append_ansi_color_code_(buf, fn_color_code_);
       buf.append(fn.data(), fn.data() + fn.size());
-      buf.append(reset.data(), reset.data() + reset.size());
+      buf.append(this->reset.data(),
+                 this->reset.data() + this->reset.size());
 
       // separator
       buf.push_back(':');
@@ -137,7 +383,7 @@ public:
     msg2.payload = spdlog::string_view_t(buf.data(), buf.size());
 
     // Delegate so the formatter still honors %^...%$ for the rest of the line.
-    spdlog::sinks::ansicolor_stderr_sink_mt::log(msg2);
+    base::log(msg2);
   }
 
 private:
@@ -210,44 +456,1689 @@ private:
   std::string fn_color_code_{"cyan"};
 };
 
+using stderr_indent_color_sink_mt =
+    stderr_indent_color_sink<spdlog::details::console_mutex>;
+using stderr_indent_color_sink_st =
+    stderr_indent_color_sink<spdlog::details::console_nullmutex>;
+
+// Collapses consecutive identical records (same site, depth and payload) per
+// thread. The first record passes through; repeats are held back and, when
+// the run ends, one line "<payload> (repeated N more times, first=..
+// last=..)" is emitted in the held record's depth/span context. A run ends
+// on a different record from that thread, after max_hold repeats, or once
+// it is max_hold_time old: on the thread's next record, or on the next
+// flush() (so a thread that goes idle or exits has its summary written
+// within max_hold_time plus the flush period, e.g. spdlog::flush_every()).
+// flush() also forgets threads idle for max_hold_time. Younger runs
+// survive flush(), so flush_on(info) keeps collapsing repeats.
+template <typename Mutex>
+class dedup_sink final : public spdlog::sinks::dist_sink<Mutex> {
+public:
+  explicit dedup_sink(std::vector<std::shared_ptr<spdlog::sinks::sink>> sinks,
+                      std::size_t max_hold = 10000,
+                      std::chrono::milliseconds max_hold_time =
+                          std::chrono::seconds(1))
+      : spdlog::sinks::dist_sink<Mutex>(std::move(sinks)),
+        max_hold_(max_hold), max_hold_time_(max_hold_time) {}
+
+  ~dedup_sink() override { flush_held(); }
+
+  // Emit the summary line of every run still being held back.
+  void flush_held() {
+    std::lock_guard<Mutex> lock(this->mutex_);
+    for (auto &kv : runs_)
+      emit_(kv.second);
+    runs_.clear();
+    spdlog::sinks::dist_sink<Mutex>::flush_();
+  }
+
+protected:
+  void sink_it_(const spdlog::details::log_msg &msg) override {
+    const std::size_t key = key_(msg);
+    run &r = runs_[msg.thread_id];
+    if (r.active && r.key == key && r.repeats < max_hold_ &&
+        msg.time - r.first < max_hold_time_) {
+      if (r.repeats++ == 0) {
+        // Copy only once a run actually starts.
+        r.held = spdlog::details::log_msg_buffer(msg);
+        r.ctx = context::capture();
+      }
+      r.last = msg.time;
+      r.seq = g_seq; // this repeat's, from depthlog::logger
+      return;
+    }
+    emit_(r);
+    r.active = true;
+    r.key = key;
+    r.first = r.last = msg.time;
+    spdlog::sinks::dist_sink<Mutex>::sink_it_(msg);
+  }
+
+  // Ends runs older than max_hold_time and drops their threads' entries,
+  // along with those of threads that have been idle that long.
+  void flush_() override {
+    const auto now = spdlog::log_clock::now();
+    for (auto it = runs_.begin(); it != runs_.end();) {
+      run &r = it->second;
+      if (now - r.first >= max_hold_time_) {
+        emit_(r);
+        it = runs_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    spdlog::sinks::dist_sink<Mutex>::flush_();
+  }
+
+private:
+  struct run {
+    bool active = false;
+    std::size_t key = 0;
+    std::size_t repeats = 0;
+    spdlog::log_clock::time_point first{};
+    spdlog::log_clock::time_point last{};
+    std::uint64_t seq = 0; // of the last repeat
+    spdlog::details::log_msg_buffer held;
+    context ctx;
+  };
+
+  static std::size_t key_(const spdlog::details::log_msg &msg) {
+    std::size_t h = std::hash<std::string_view>{}(
+        std::string_view(msg.payload.data(), msg.payload.size()));
+    const auto mix = [&h](std::size_t v) {
+      h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    };
+    mix(reinterpret_cast<std::uintptr_t>(msg.source.filename));
+    mix(static_cast<std::size_t>(msg.source.line));
+    mix(static_cast<std::size_t>(g_depth));
+    return h;
+  }
+
+  static void append_time_(spdlog::memory_buf_t &buf,
+                           spdlog::log_clock::time_point tp) {
+    const auto t = spdlog::log_clock::to_time_t(tp);
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        tp.time_since_epoch())
+                        .count() %
+                    1000;
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    fmt::format_to(std::back_inserter(buf), "{:02}:{:02}:{:02}.{:03}",
+                   tm.tm_hour, tm.tm_min, tm.tm_sec, ms);
+  }
+
+  void emit_(run &r) {
+    if (r.repeats == 0) {
+      r.active = false;
+      return;
+    }
+    spdlog::memory_buf_t buf;
+    buf.append(r.held.payload.data(),
+               r.held.payload.data() + r.held.payload.size());
+    fmt::format_to(std::back_inserter(buf), " (repeated {} more times, first=",
+                   r.repeats);
+    append_time_(buf, r.first);
+    static constexpr char kLast[] = " last=";
+    buf.append(kLast, kLast + sizeof(kLast) - 1);
+    append_time_(buf, r.last);
+    buf.push_back(')');
+
+    spdlog::details::log_msg summary = r.held;
+    summary.payload = spdlog::string_view_t(buf.data(), buf.size());
+    summary.time = r.last;
+    context_guard guard(r.ctx);
+    // %Q: the summary takes the last repeat's seq, which keeps the held
+    // thread's seqs monotonic whichever thread (or flush) emits it.
+    struct seq_guard {
+      std::uint64_t saved = g_seq;
+      ~seq_guard() { g_seq = saved; }
+    } seq_restore;
+    g_seq = r.seq;
+    spdlog::sinks::dist_sink<Mutex>::sink_it_(summary);
+    r.repeats = 0;
+    r.active = false;
+  }
+
+  std::size_t max_hold_;
+  std::chrono::milliseconds max_hold_time_;
+  std::unordered_map<std::size_t, run> runs_;
+};
+
+using dedup_sink_mt = dedup_sink<std::mutex>;
+using dedup_sink_st = dedup_sink<spdlog::details::null_mutex>;
+
 constexpr auto max_size = 20ull * 1024 * 1024 * 1024; // 20GB
 constexpr auto max_files = 1;
 
-inline std::unique_ptr<spdlog::formatter> make_logfmt_formatter() {
+// How rotated segments are compressed (in the background).
+enum class compression {
+  none,
+  lz4,  // built-in LZ4 frame codec, "<segment>.lz4"
+  zstd, // the zstd binary from PATH, "<segment>.zst"; lz4 if not found
+};
+
+// When a file sink starts a new segment, and which old ones it keeps.
+// Segments rotate like rotating_file_sink: file.log -> file.1.log -> ...
+struct rotation_policy {
+  std::size_t max_size = depthlog::max_size; // bytes per segment
+  std::chrono::seconds max_age{0};           // 0: no time-based rotation
+  std::size_t max_files = depthlog::max_files; // rotated segments kept
+  std::uint64_t max_total_size = 0; // of rotated segments; 0: no limit
+  compression compress = compression::none;
+};
+
+// How a file sink writes its segments.
+struct io_policy {
+  // Reserve disk space ahead of the write position with
+  // fallocate(FALLOC_FL_KEEP_SIZE), in extents of this many bytes (the
+  // whole segment if >= rotation_policy::max_size), so a growing log gets
+  // few large extents instead of an allocation on every append. What is
+  // left unused is released when the segment is closed. 0: off.
+  std::uint64_t preallocate = 0;
+  // Write back and drop from the page cache whatever is more than this
+  // many bytes behind the write position (sync_file_range, then
+  // POSIX_FADV_DONTNEED), so multi-GB logs do not evict the service's
+  // working set. 0: off.
+  std::uint64_t drop_behind = 0;
+  // Write the log with O_DIRECT, bypassing the page cache altogether
+  // (see detail::direct_file; drop_behind is then moot). Records reach the
+  // disk in 1 MiB chunks or on flush, which then costs a synchronous
+  // block write: raise the flush level accordingly. Falls back to
+  // buffered I/O on file systems without O_DIRECT.
+  bool direct = false;
+};
+
+namespace detail {
+
+// Runs posted jobs in order on its own thread; the destructor finishes the
+// queued jobs, then joins. A positive nice value lowers the thread's CPU
+// priority.
+class job_thread {
+public:
+  explicit job_thread(int nice) : thread_([this, nice] { run_(nice); }) {}
+  job_thread(const job_thread &) = delete;
+  job_thread &operator=(const job_thread &) = delete;
+  ~job_thread() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  void post(std::function<void()> job) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      jobs_.push_back(std::move(job));
+    }
+    cv_.notify_one();
+  }
+
+private:
+  void run_(int nice) {
+    if (nice > 0)
+      ::setpriority(PRIO_PROCESS,
+                    static_cast<id_t>(spdlog::details::os::thread_id()), nice);
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+      if (jobs_.empty())
+        return;
+      auto job = std::move(jobs_.front());
+      jobs_.pop_front();
+      lock.unlock();
+      try {
+        job();
+      } catch (const std::exception &ex) {
+        std::fprintf(stderr, "[*** LOG ERROR ***] [depthlog rotation] %s\n",
+                     ex.what());
+      }
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> jobs_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+} // namespace detail
+
+// Background threads for file sink rotation, so that a logging thread
+// crossing a rotation threshold only swaps pointers. Opening the next
+// segment is latency-sensitive (until it is ready the sink keeps writing
+// the full one) and gets its own thread; closing, renaming, compressing
+// and deleting old segments run on a second, lower-priority one, so
+// compression does not compete with logging threads. Jobs of each kind
+// run in submission order. One manager can serve many sinks.
+class rotation_manager {
+public:
+  // Opening segments, reserving space.
+  void open(std::function<void()> job) { opener_.post(std::move(job)); }
+  // Retiring segments, dropping written pages from the page cache.
+  void background(std::function<void()> job) {
+    housekeeper_.post(std::move(job));
+  }
+
+private:
+  detail::job_thread opener_{0};
+  detail::job_thread housekeeper_{10};
+};
+
+namespace detail {
+
+// Reserves [offset, offset + len) of fd without changing its size.
+inline void reserve_space(int fd, std::uint64_t offset,
+                          std::uint64_t len) noexcept {
+#ifdef __linux__
+  ::fallocate(fd, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset),
+              static_cast<off_t>(len));
+#else
+  (void)fd, (void)offset, (void)len;
+#endif
+}
+
+// Starts writeback of [offset, offset + len) and waits for it to finish,
+// then evicts it from the page cache (dirty pages cannot be evicted).
+inline void drop_written(int fd, std::uint64_t offset,
+                         std::uint64_t len) noexcept {
+#ifdef __linux__
+  ::sync_file_range(fd, static_cast<off_t>(offset), static_cast<off_t>(len),
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                        SYNC_FILE_RANGE_WAIT_AFTER);
+#endif
+  ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(len),
+                  POSIX_FADV_DONTNEED);
+}
+
+// Log file written with O_DIRECT. Records are staged in two 4 KiB-aligned
+// buffers: while the I/O thread writes one, the logging thread fills the
+// other. Only whole blocks reach the disk, so flush() writes the partial
+// last block padded with NULs and keeps it staged, to be rewritten as it
+// fills; close() truncates the padding away. A crash can leave up to one
+// block of NULs at the end of the file: readers skip them, and reopening
+// the file for append trims them.
+class direct_file {
+public:
+  static constexpr std::size_t kAlign = 4096;
+  static constexpr std::size_t kBufferSize = std::size_t{1} << 20;
+
+  direct_file(const std::string &path, bool truncate) : path_(path) {
+    const int flags = O_RDWR | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0);
+#ifdef O_DIRECT
+    fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+    if (fd_ < 0 && errno == EINVAL) // no O_DIRECT on this file system
+#endif
+      fd_ = ::open(path.c_str(), flags, 0644);
+    if (fd_ < 0)
+      spdlog::throw_spdlog_ex("depthlog: cannot open " + path, errno);
+    for (auto &b : buffers_) {
+      b.reset(static_cast<char *>(std::aligned_alloc(kAlign, kBufferSize)));
+      if (!b) {
+        ::close(fd_);
+        throw std::bad_alloc();
+      }
+    }
+    if (!truncate && !load_tail_()) {
+      const int err = errno;
+      ::close(fd_);
+      spdlog::throw_spdlog_ex("depthlog: cannot read " + path, err);
+    }
+    io_ = std::thread([this] { run_(); });
+  }
+  direct_file(const direct_file &) = delete;
+  direct_file &operator=(const direct_file &) = delete;
+
+  ~direct_file() {
+    try {
+      flush();
+    } catch (const std::exception &ex) {
+      std::fprintf(stderr, "[*** LOG ERROR ***] [depthlog] %s\n", ex.what());
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    io_.join();
+    // Tail fix-up: cut the padding of the last block.
+    (void)!::ftruncate(fd_, static_cast<off_t>(size()));
+    ::close(fd_);
+  }
+
+  int fd() const noexcept { return fd_; }
+
+  // Bytes of records, staged ones included.
+  std::uint64_t size() const noexcept { return base_ + used_; }
+
+  void write(const char *p, std::size_t n) {
+    while (n) {
+      const auto take = std::min(n, kBufferSize - used_);
+      std::memcpy(current_() + used_, p, take);
+      used_ += take;
+      p += take;
+      n -= take;
+      if (used_ == kBufferSize)
+        submit_();
+    }
+  }
+
+  // Writes everything staged, the last block padded.
+  void flush() {
+    wait_idle_();
+    const auto len = (used_ + kAlign - 1) / kAlign * kAlign;
+    if (len == 0)
+      return;
+    char *buf = current_();
+    std::memset(buf + used_, 0, len - used_);
+    if (const int err = write_all_(fd_, buf, len, base_))
+      spdlog::throw_spdlog_ex("depthlog: failed writing to " + path_, err);
+    // Keep only the partial block staged.
+    const auto whole = used_ / kAlign * kAlign;
+    std::memmove(buf, buf + whole, used_ - whole);
+    base_ += whole;
+    used_ -= whole;
+  }
+
+private:
+  struct free_deleter {
+    void operator()(char *p) const noexcept { std::free(p); }
+  };
+
+  char *current_() const noexcept { return buffers_[current_index_].get(); }
+
+  // Stages the file's last block, minus any padding a crash left behind.
+  bool load_tail_() {
+    struct stat st {};
+    if (::fstat(fd_, &st) != 0)
+      return false;
+    const auto size = static_cast<std::uint64_t>(st.st_size);
+    if (size == 0)
+      return true;
+    base_ = (size - 1) / kAlign * kAlign;
+    const auto n = ::pread(fd_, current_(), kAlign, static_cast<off_t>(base_));
+    if (n < 0)
+      return false;
+    used_ = static_cast<std::size_t>(n);
+    while (used_ && current_()[used_ - 1] == '\0')
+      --used_;
+    return true;
+  }
+
+  // Hands the full current buffer to the I/O thread and switches to the
+  // other one once its previous write is done.
+  void submit_() {
+    wait_idle_();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_ = current_();
+      pending_offset_ = base_;
+    }
+    cv_.notify_all();
+    base_ += kBufferSize;
+    used_ = 0;
+    current_index_ ^= 1;
+  }
+
+  void wait_idle_() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return pending_ == nullptr; });
+    if (error_) {
+      const int err = error_;
+      error_ = 0;
+      spdlog::throw_spdlog_ex("depthlog: failed writing to " + path_, err);
+    }
+  }
+
+  static int write_all_(int fd, const char *p, std::size_t n,
+                        std::uint64_t offset) noexcept {
+    while (n) {
+      const auto w = ::pwrite(fd, p, n, static_cast<off_t>(offset));
+      if (w < 0) {
+        if (errno == EINTR)
+          continue;
+        return errno;
+      }
+      p += w;
+      n -= static_cast<std::size_t>(w);
+      offset += static_cast<std::uint64_t>(w);
+    }
+    return 0;
+  }
+
+  void run_() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      cv_.wait(lock, [this] { return stop_ || pending_; });
+      if (!pending_)
+        return;
+      const char *buf = pending_;
+      const auto offset = pending_offset_;
+      lock.unlock();
+      const int err = write_all_(fd_, buf, kBufferSize, offset);
+      lock.lock();
+      pending_ = nullptr;
+      if (err)
+        error_ = err;
+      cv_.notify_all();
+    }
+  }
+
+  std::string path_;
+  int fd_ = -1;
+  std::unique_ptr<char, free_deleter> buffers_[2];
+  unsigned current_index_ = 0;
+  std::size_t used_ = 0;    // bytes staged in the current buffer
+  std::uint64_t base_ = 0;  // file offset of the current buffer
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  const char *pending_ = nullptr; // buffer being written, guarded by mutex_
+  std::uint64_t pending_offset_ = 0;
+  int error_ = 0; // of the last background write
+  bool stop_ = false;
+  std::thread io_;
+};
+
+// One open segment: the log file and its sidecar index. The log is a
+// plain stdio stream in append mode, with the descriptor at hand for
+// space reservation and page cache advice, or a direct_file.
+struct log_segment {
+  std::string path; // where it was opened
+  std::FILE *file = nullptr;
+  std::unique_ptr<direct_file> direct; // instead of file
+  std::FILE *index = nullptr;
+  std::uint64_t reserved = 0; // end of the space reserved with fallocate
+
+  log_segment(std::string p, bool truncate, std::uint32_t block_size,
+              std::uint64_t reserve = 0, bool direct_io = false)
+      : path(std::move(p)) {
+    using namespace spdlog::details;
+    os::create_dir(os::dir_name(path));
+    if (direct_io)
+      direct = std::make_unique<direct_file>(path, truncate);
+    else
+      file = std::fopen(path.c_str(), truncate ? "wb" : "ab");
+    if (!file && !direct)
+      spdlog::throw_spdlog_ex("depthlog: cannot open " + path, errno);
+    if (reserve) {
+      reserved = size() + reserve;
+      reserve_space(fd(), 0, reserved);
+    }
+    const auto idx = path + ".idx";
+    index = std::fopen(idx.c_str(), truncate ? "wb" : "ab");
+    if (!index)
+      spdlog::throw_spdlog_ex("depthlog: cannot open index " + idx, errno);
+    if (truncate || std::ftell(index) == 0) {
+      char header[index_format::kHeaderSize];
+      index_format::encode_header(header, block_size);
+      std::fwrite(header, 1, sizeof header, index);
+    }
+  }
+  log_segment(const log_segment &) = delete;
+  log_segment &operator=(const log_segment &) = delete;
+  ~log_segment() {
+    if (index)
+      std::fclose(index);
+    direct.reset(); // truncates to size() itself
+    if (!file)
+      return;
+    std::fflush(file);
+    // Hand back the reserved blocks past the end of the data.
+    if (reserved)
+      (void)!::ftruncate(fd(), static_cast<off_t>(size()));
+    std::fclose(file);
+  }
+
+  int fd() const noexcept { return direct ? direct->fd() : ::fileno(file); }
+
+  std::uint64_t size() const {
+    if (direct)
+      return direct->size();
+    struct stat st {};
+    if (::fstat(fd(), &st) != 0)
+      spdlog::throw_spdlog_ex("depthlog: cannot stat " + path, errno);
+    return static_cast<std::uint64_t>(st.st_size);
+  }
+
+  void write(const spdlog::memory_buf_t &buf) {
+    if (direct)
+      return direct->write(buf.data(), buf.size());
+    if (std::fwrite(buf.data(), 1, buf.size(), file) != buf.size())
+      spdlog::throw_spdlog_ex("depthlog: failed writing to " + path, errno);
+  }
+
+  void flush() {
+    if (direct)
+      direct->flush();
+    else if (std::fflush(file) != 0)
+      spdlog::throw_spdlog_ex("depthlog: failed flushing " + path, errno);
+    std::fflush(index);
+  }
+};
+
+// The segment a sink switches to next, opened ahead by the manager.
+struct segment_slot {
+  std::mutex mutex;
+  std::unique_ptr<log_segment> segment;
+};
+
+// Renames a rotated segment with whatever compressed form and index it has.
+inline void rename_segment(const std::string &from, const std::string &to) {
+  using spdlog::details::os::path_exists;
+  using spdlog::details::os::rename;
+  for (const char *sfx : {"", ".lz4", ".zst", ".idx"})
+    if (path_exists(from + sfx))
+      rename(from + sfx, to + sfx);
+}
+
+inline void remove_segment(const std::string &path) {
+  for (const char *sfx : {"", ".lz4", ".zst", ".idx"})
+    spdlog::details::os::remove(path + sfx);
+}
+
+// Size of a rotated segment's log data, compressed or not.
+inline std::uint64_t segment_bytes(const std::string &path) {
+  std::uint64_t n = 0;
+  for (const char *sfx : {"", ".lz4", ".zst"}) {
+    struct stat st {};
+    if (::stat((path + sfx).c_str(), &st) == 0)
+      n += static_cast<std::uint64_t>(st.st_size);
+  }
+  return n;
+}
+
+// zstd -q --rm path; false if zstd is missing or fails.
+inline bool run_zstd(const std::string &path) {
+  const char *argv[] = {"zstd", "-q", "-f", "--rm", path.c_str(), nullptr};
+  pid_t pid;
+  if (::posix_spawnp(&pid, "zstd", nullptr, nullptr,
+                     const_cast<char *const *>(argv), environ) != 0)
+    return false;
+  int status = 0;
+  while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+inline void compress_segment(const std::string &path, compression how) {
+  if (how == compression::none || !spdlog::details::os::path_exists(path))
+    return;
+  if (how == compression::zstd && run_zstd(path))
+    return;
+  if (lz4::compress_file(path, path + ".lz4"))
+    spdlog::details::os::remove(path);
+}
+
+// Runs on the manager's housekeeping thread after a sink switched from
+// `done` (at base, once earlier retire jobs ran) to the segment it had
+// prepared at `next`.
+inline void retire_segment(std::shared_ptr<log_segment> done,
+                           const std::string &base, const std::string &next,
+                           const rotation_policy &policy) {
+  using calc = spdlog::sinks::rotating_file_sink_st;
+  done.reset(); // flush and close
+
+  const auto name = [&](std::size_t i) {
+    return calc::calc_filename(base, i);
+  };
+  if (policy.max_files == 0) {
+    remove_segment(base);
+  } else {
+    remove_segment(name(policy.max_files));
+    for (auto i = policy.max_files; i > 1; --i)
+      rename_segment(name(i - 1), name(i));
+    rename_segment(base, name(1));
+  }
+  rename_segment(next, base);
+  if (policy.max_files == 0)
+    return;
+
+  compress_segment(name(1), policy.compress);
+  if (policy.max_total_size) {
+    std::uint64_t total = 0;
+    for (std::size_t i = 1; i <= policy.max_files; ++i)
+      total += segment_bytes(name(i));
+    for (auto i = policy.max_files; i >= 1 && total > policy.max_total_size;
+         --i) {
+      total -= segment_bytes(name(i));
+      remove_segment(name(i));
+    }
+  }
+}
+
+} // namespace detail
+
+inline std::unique_ptr<spdlog::formatter>
+make_logfmt_formatter(const std::string &pattern = kLogfmtPattern) {
   auto f = spdlog::details::make_unique<spdlog::pattern_formatter>();
-  f->add_flag<depthlog::depth_flag>('D');
-  f->set_pattern(
-      R"(ts="%Y-%m-%dT%H:%M:%S.%e%z" level=%l depth=%D tid=%t file="%s" line=%# func="%!" msg="%v")");
+  add_depthlog_flags(*f);
+  f->set_pattern(pattern);
   return f;
 }
 
-inline void init(const std::string &log_file_prefix) {
-  auto file_sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
-      depthlog::make_log_filename(log_file_prefix), max_size, max_files);
-  // Set per-sink formatters
-  file_sink->set_formatter(make_logfmt_formatter());
+// Rotating file sink that also writes a sidecar index ("<file>.idx", see
+// index_format.hpp): one entry per block_size bytes of records with the
+// block's offset, time range, tid bloom filter, max depth and levels, so
+// readers can seek straight to a time range or thread.
+//
+// Rotation follows rotation_policy without blocking the logging thread:
+// once a segment is half way to its size or age limit, the manager opens
+// the next one as "<file>.next-<n>"; at the limit the sink swaps it in and
+// leaves closing, renaming (index files included), compressing and
+// pruning to the manager. If the next segment is not ready yet, the sink
+// keeps writing the current one rather than wait.
+//
+// io_policy: extents are reserved one ahead on the opener thread (the
+// first with the segment itself), and page cache drops run on the
+// housekeeper, each on its own dup of the descriptor so a segment can be
+// swapped out under them.
+template <typename Mutex>
+class indexed_file_sink final : public spdlog::sinks::base_sink<Mutex> {
+public:
+  explicit indexed_file_sink(std::string filename,
+                             rotation_policy policy = {},
+                             io_policy io = {},
+                             std::shared_ptr<rotation_manager> manager = {},
+                             std::size_t block_size = 64 * 1024)
+      : base_filename_(std::move(filename)), policy_(policy), io_(io),
+        block_size_(block_size), manager_(std::move(manager)),
+        next_(std::make_shared<detail::segment_slot>()) {
+    if (!manager_)
+      manager_ = std::make_shared<rotation_manager>();
+    active_ = std::make_unique<detail::log_segment>(
+        base_filename_, false, static_cast<std::uint32_t>(block_size_),
+        extent_(), io_.direct);
+    current_size_ = active_->size();
+    dropped_ = current_size_;
+    opened_ = spdlog::log_clock::now();
+    block_.offset = current_size_;
+  }
+
+  ~indexed_file_sink() override {
+    if (block_.records)
+      write_entry_();
+    active_.reset();
+    // Drop a prepared segment that was never used, once it is ready.
+    manager_->open([slot = next_] {
+      std::lock_guard<std::mutex> lock(slot->mutex);
+      if (slot->segment) {
+        const auto path = slot->segment->path;
+        slot->segment.reset();
+        detail::remove_segment(path);
+      }
+    });
+  }
+
+  const std::string &filename() const { return base_filename_; }
+
+protected:
+  void sink_it_(const spdlog::details::log_msg &msg) override {
+    spdlog::memory_buf_t formatted;
+    this->formatter_->format(msg, formatted);
+    if (current_size_ > 0) {
+      if (!next_requested_ && reached_(formatted.size(), msg.time, 2))
+        request_next_();
+      if (reached_(formatted.size(), msg.time, 1))
+        swap_segment_(msg.time);
+    }
+    active_->write(formatted);
+    current_size_ += formatted.size();
+    if (io_.preallocate)
+      reserve_ahead_();
+    if (io_.drop_behind && !io_.direct)
+      drop_behind_();
+
+    const auto ts = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        msg.time.time_since_epoch())
+                        .count();
+    if (block_.records++ == 0) {
+      block_.first_ts_ns = ts;
+      block_.max_depth = g_depth;
+    }
+    block_.first_ts_ns = std::min<std::int64_t>(block_.first_ts_ns, ts);
+    block_.last_ts_ns = std::max<std::int64_t>(block_.last_ts_ns, ts);
+    block_.max_depth = std::max(block_.max_depth, g_depth);
+    block_.level_mask |= 1u << static_cast<unsigned>(msg.level);
+    index_format::bloom_add(block_, msg.thread_id);
+    block_.length += formatted.size();
+    if (block_.length >= block_size_)
+      write_entry_();
+  }
+
+  // Does not cut the block: the unindexed tail is scanned by readers.
+  void flush_() override { active_->flush(); }
+
+private:
+  // Whether the segment is at 1/div of its size or age limit.
+  bool reached_(std::size_t incoming, spdlog::log_clock::time_point t,
+                unsigned div) const {
+    if (current_size_ + incoming > policy_.max_size / div)
+      return true;
+    return policy_.max_age.count() > 0 &&
+           (t - opened_) * div >= policy_.max_age;
+  }
+
+  // Preallocation extent: io_policy::preallocate, at most a segment.
+  std::uint64_t extent_() const {
+    return std::min<std::uint64_t>(io_.preallocate, policy_.max_size);
+  }
+
+  // Once the writes are half way into the last reserved extent, reserve
+  // the next one (never past the segment's size limit).
+  void reserve_ahead_() {
+    const auto extent = extent_();
+    auto &seg = *active_;
+    if (current_size_ + extent / 2 < seg.reserved ||
+        seg.reserved >= policy_.max_size)
+      return;
+    const auto len =
+        std::min<std::uint64_t>(extent, policy_.max_size - seg.reserved);
+    const int fd = ::dup(seg.fd());
+    if (fd < 0)
+      return;
+    manager_->open([fd, offset = seg.reserved, len] {
+      detail::reserve_space(fd, offset, len);
+      ::close(fd);
+    });
+    seg.reserved += len;
+  }
+
+  // Drops whole drop_behind windows that are at least a window behind
+  // the write position.
+  void drop_behind_() {
+    const auto window = io_.drop_behind;
+    if (current_size_ - dropped_ < 2 * window)
+      return;
+    const int fd = ::dup(active_->fd());
+    if (fd < 0)
+      return;
+    const auto len = (current_size_ - dropped_ - window) / window * window;
+    manager_->background([fd, offset = dropped_, len] {
+      detail::drop_written(fd, offset, len);
+      ::close(fd);
+    });
+    dropped_ += len;
+  }
+
+  void request_next_() {
+    next_requested_ = true;
+    const auto next = base_filename_ + ".next-" + std::to_string(++segments_);
+    manager_->open([slot = next_, next,
+                    block_size = static_cast<std::uint32_t>(block_size_),
+                    reserve = extent_(), direct = io_.direct] {
+      auto seg = std::make_unique<detail::log_segment>(next, true, block_size,
+                                                       reserve, direct);
+      std::lock_guard<std::mutex> lock(slot->mutex);
+      slot->segment = std::move(seg);
+    });
+  }
+
+  void swap_segment_(spdlog::log_clock::time_point now) {
+    std::unique_ptr<detail::log_segment> next;
+    {
+      std::unique_lock<std::mutex> lock(next_->mutex, std::try_to_lock);
+      if (lock.owns_lock())
+        next = std::move(next_->segment);
+    }
+    if (!next)
+      return; // not ready yet: keep writing this one
+    if (block_.records)
+      write_entry_();
+    std::shared_ptr<detail::log_segment> done(std::move(active_));
+    active_ = std::move(next);
+    current_size_ = 0;
+    dropped_ = 0;
+    opened_ = now;
+    block_ = index_format::entry{};
+    next_requested_ = false;
+    manager_->background([done = std::move(done), base = base_filename_,
+                      next = active_->path, policy = policy_]() mutable {
+      detail::retire_segment(std::move(done), base, next, policy);
+    });
+  }
+
+  void write_entry_() {
+    std::fwrite(&block_, sizeof block_, 1, active_->index);
+    const auto next = block_.offset + block_.length;
+    block_ = index_format::entry{};
+    block_.offset = next;
+  }
+
+  std::string base_filename_;
+  rotation_policy policy_;
+  io_policy io_;
+  std::size_t block_size_;
+  std::size_t current_size_ = 0;
+  std::uint64_t dropped_ = 0; // written pages before this were dropped
+  spdlog::log_clock::time_point opened_;
+  bool next_requested_ = false;
+  std::uint64_t segments_ = 0; // prepared so far, for unique names
+  std::shared_ptr<rotation_manager> manager_;
+  std::shared_ptr<detail::segment_slot> next_;
+  std::unique_ptr<detail::log_segment> active_;
+  index_format::entry block_;
+};
+
+using indexed_file_sink_mt = indexed_file_sink<std::mutex>;
+using indexed_file_sink_st = indexed_file_sink<spdlog::details::null_mutex>;
+
+// One indexed file per thread: "<stem>.tid-<n>.log", n being the OS
+// thread id (the tid= field). A thread writes only to its own shard, so
+// the write path takes no lock shared with other threads (the shard's own
+// mutex is contended only by flush()); the registry mutex is taken once
+// per thread (shard creation) and by flush() and set_formatter().
+// tools/depthlog_merge restores a global order. All shards rotate by the
+// same policy and share one rotation_manager.
+//
+// A thread marks its shards on exit; the next flush() closes them, so
+// pools that churn threads do not pile up descriptors (and, with
+// io_policy::direct, writer threads and buffers). A thread that reuses an
+// exited thread's tid before then picks its shard up again.
+class thread_sharded_file_sink final : public spdlog::sinks::sink {
+public:
+  explicit thread_sharded_file_sink(std::string stem,
+                                    rotation_policy policy = {},
+                                    io_policy io = {})
+      : stem_(std::move(stem)), policy_(policy), io_(io),
+        manager_(std::make_shared<rotation_manager>()), id_(next_id_()),
+        formatter_(make_logfmt_formatter()) {}
+
+  void log(const spdlog::details::log_msg &msg) override {
+    shard &s = local_shard_();
+    const auto gen = generation_.load(std::memory_order_acquire);
+    if (s.generation != gen) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      s.file->set_formatter(formatter_->clone());
+      s.generation = generation_.load(std::memory_order_relaxed);
+    }
+    s.file->log(msg);
+  }
+
+  // Flushes every shard from the calling thread, under each shard's own
+  // lock: the owning thread may be rotating it at the same time. Shards
+  // of exited threads are closed.
+  void flush() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = shards_.begin(); it != shards_.end();) {
+      if (it->second->exited.load(std::memory_order_acquire)) {
+        it = shards_.erase(it); // flushes and closes the segment
+      } else {
+        it->second->file->flush();
+        ++it;
+      }
+    }
+  }
+
+  void set_pattern(const std::string &pattern) override {
+    set_formatter(spdlog::details::make_unique<spdlog::pattern_formatter>(
+        pattern));
+  }
+
+  // Each shard picks up a clone of the formatter on its next record.
+  void set_formatter(std::unique_ptr<spdlog::formatter> f) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    formatter_ = std::move(f);
+    generation_.fetch_add(1, std::memory_order_release);
+  }
+
+  const std::string &stem() const noexcept { return stem_; }
+
+private:
+  // _mt, not _st: flush() (spdlog::flush_every, flush_on, shutdown) walks
+  // every shard from whichever thread calls it, and the shard mutex keeps
+  // that from touching a segment the owner is closing during rotation.
+  // Uncontended apart from flushes, so the write path stays cheap.
+  using file_t = indexed_file_sink_mt;
+
+  struct shard {
+    std::unique_ptr<file_t> file;
+    std::uint64_t generation = 0;
+    std::atomic<bool> exited{false}; // set by the owner's thread_shards
+  };
+
+  // Per thread: a single-entry cache keyed by sink id (not address, which
+  // a later sink could reuse), and every shard the thread owns, to be
+  // marked exited when the thread ends. Weak, as sinks may go first.
+  struct thread_shards {
+    std::uint64_t sink = 0;
+    shard *s = nullptr;
+    std::vector<std::weak_ptr<shard>> owned;
+
+    ~thread_shards() {
+      for (auto &w : owned)
+        if (auto sp = w.lock())
+          sp->exited.store(true, std::memory_order_release);
+    }
+  };
+
+  static std::uint64_t next_id_() {
+    static std::atomic<std::uint64_t> id{0};
+    return id.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+  // Misses of the thread-local cache go through the registry.
+  shard &local_shard_() {
+    thread_local thread_shards t;
+    if (t.sink == id_)
+      return *t.s;
+
+    const auto tid = spdlog::details::os::thread_id();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &slot = shards_[tid];
+    if (!slot) {
+      slot = std::make_shared<shard>();
+      slot->file = std::make_unique<file_t>(
+          stem_ + ".tid-" + std::to_string(tid) + ".log", policy_, io_,
+          manager_);
+      slot->file->set_formatter(formatter_->clone());
+      slot->generation = generation_.load(std::memory_order_relaxed);
+    }
+    slot->exited.store(false, std::memory_order_relaxed);
+    const auto stale = [&](const std::weak_ptr<shard> &w) {
+      const auto sp = w.lock();
+      return !sp || sp == slot;
+    };
+    t.owned.erase(std::remove_if(t.owned.begin(), t.owned.end(), stale),
+                  t.owned.end());
+    t.owned.push_back(slot);
+    t.sink = id_;
+    t.s = slot.get();
+    return *slot;
+  }
+
+  std::string stem_;
+  rotation_policy policy_;
+  io_policy io_;
+  std::shared_ptr<rotation_manager> manager_;
+  std::uint64_t id_;
+  std::mutex mutex_;
+  std::unique_ptr<spdlog::formatter> formatter_;
+  std::atomic<std::uint64_t> generation_{0};
+  std::unordered_map<std::size_t, std::shared_ptr<shard>> shards_;
+};
+
+// Default pattern of the indenting stderr sink.
+inline constexpr const char *kStderrPattern =
+    R"(%H:%M:%S [%^%1!L%$] %20s:%-6# | %v)";
+
+// Immutable runtime configuration. Producers read the current snapshot
+// through one atomic pointer load inside an epoch guard; apply_config()
+// publishes a new one and retires the old one without blocking them.
+struct config {
+  spdlog::level::level_enum level = spdlog::level::info;
+  spdlog::level::level_enum flush_level = spdlog::level::info;
+  std::array<int, spdlog::level::n_levels> max_depth{
+      INT_MAX, INT_MAX, INT_MAX, INT_MAX, INT_MAX, INT_MAX, INT_MAX};
+  std::string file_pattern = kLogfmtPattern;
+  std::string stderr_pattern = kStderrPattern;
+  // Set through depthlog::logger's set_pattern()/set_formatter() (and so
+  // by spdlog::set_pattern()): every sink then formats with a clone of it
+  // instead of the patterns above. Setting either pattern key clears it.
+  std::shared_ptr<const spdlog::formatter> formatter;
+  // Sinks of depthlog::logger; empty in apply_config() keeps the current.
+  std::vector<spdlog::sink_ptr> sinks;
+  std::uint64_t version = 0; // assigned on publish
+};
+
+namespace detail {
+
+inline std::atomic<const config *> &config_ptr() noexcept {
+  static std::atomic<const config *> p{nullptr};
+  return p;
+}
+
+// Owns the published snapshot so it is freed at exit.
+inline std::unique_ptr<const config> &config_owner() {
+  static std::unique_ptr<const config> owner;
+  return owner;
+}
+
+inline std::mutex &config_write_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+// What stands in for a snapshot before the first one (init()): defaults,
+// with the depth caps set_max_depth() stored so far.
+inline config initial_config() {
+  config c;
+  for (int i = 0; i < spdlog::level::n_levels; ++i)
+    c.max_depth[i] = g_max_depth[i].load(std::memory_order_relaxed);
+  return c;
+}
+
+// apply_config() with config_write_mutex() held. Levels and depth caps go
+// to their atomics; patterns are picked up by config_formatter on the next
+// record.
+inline void publish_config(config c) {
+  const config *old = config_ptr().load(std::memory_order_relaxed);
+  if (c.sinks.empty() && old)
+    c.sinks = old->sinks;
+  c.version = old ? old->version + 1 : 1;
+
+  for (int i = 0; i < spdlog::level::n_levels; ++i)
+    store_max_depth(static_cast<spdlog::level::level_enum>(i),
+                    c.max_depth[i]);
+  if (auto lg = spdlog::default_logger_raw()) {
+    lg->set_level(c.level);
+    lg->flush_on(c.flush_level);
+  }
+
+  auto next = std::make_unique<const config>(std::move(c));
+  config_ptr().store(next.get(), std::memory_order_seq_cst);
+  auto prev = std::move(config_owner());
+  config_owner() = std::move(next);
+  if (prev)
+    epoch_domain::instance().retire([p = prev.release()] { delete p; });
+}
+
+// Publishes a copy of the current snapshot (initial_config() before
+// init()) as modified by edit(config &), atomically with respect to other
+// writers. If edit throws, nothing is published.
+template <class Edit> void update_config(Edit &&edit) {
+  std::lock_guard<std::mutex> lock(config_write_mutex());
+  const config *old = config_ptr().load(std::memory_order_relaxed);
+  config c = old ? *old : initial_config();
+  edit(c);
+  publish_config(std::move(c));
+}
+
+// The one entry of depthlog::logger's own sink list. Records never reach
+// it (the logger dispatches to the snapshot's sinks); it is there because
+// spdlog::logger::set_pattern()/set_formatter(), and spdlog::set_pattern(),
+// hand their formatter to each sink of the logger: this puts it into the
+// config, for every snapshot sink.
+class config_formatter_slot final : public spdlog::sinks::sink {
+public:
+  void log(const spdlog::details::log_msg &) override {}
+  void flush() override {}
+
+  void set_pattern(const std::string &pattern) override {
+    set_formatter(
+        spdlog::details::make_unique<spdlog::pattern_formatter>(pattern));
+  }
+
+  void set_formatter(std::unique_ptr<spdlog::formatter> f) override {
+    std::shared_ptr<const spdlog::formatter> shared(std::move(f));
+    update_config([&](config &c) { c.formatter = std::move(shared); });
+  }
+};
+
+} // namespace detail
+
+// Installed by init() on its sinks: formats with the current snapshot's
+// pattern (or formatter), rebuilding the inner formatter only when the
+// version changes. Runs under the owning sink's mutex like any other sink
+// formatter.
+class config_formatter final : public spdlog::formatter {
+public:
+  enum class role { file, console };
+
+  explicit config_formatter(role r) : role_(r) {}
+
+  void format(const spdlog::details::log_msg &msg,
+              spdlog::memory_buf_t &dest) override {
+    detail::epoch_guard guard;
+    const config *c = detail::config_ptr().load(std::memory_order_acquire);
+    if (c && (!inner_ || version_ != c->version)) {
+      if (c->formatter)
+        inner_ = c->formatter->clone();
+      else if (role_ == role::file)
+        inner_ = make_logfmt_formatter(c->file_pattern);
+      else
+        inner_ = spdlog::details::make_unique<spdlog::pattern_formatter>(
+            c->stderr_pattern);
+      version_ = c->version;
+    }
+    if (!inner_)
+      inner_ = make_logfmt_formatter();
+    inner_->format(msg, dest);
+  }
+
+  std::unique_ptr<spdlog::formatter> clone() const override {
+    return spdlog::details::make_unique<config_formatter>(role_);
+  }
+
+private:
+  role role_;
+  std::uint64_t version_ = 0;
+  std::unique_ptr<spdlog::formatter> inner_;
+};
+
+// Logger used by init(): dispatches to the sinks of the current config
+// snapshot instead of a fixed sink list. set_pattern()/set_formatter()
+// apply to all of them through the config (see config::formatter).
+class logger final : public spdlog::logger {
+public:
+  explicit logger(std::string name)
+      : spdlog::logger(std::move(name),
+                       std::make_shared<detail::config_formatter_slot>()) {}
+
+protected:
+  void sink_it_(const spdlog::details::log_msg &msg) override {
+    next_seq();
+    {
+      detail::epoch_guard guard;
+      const config *c = detail::config_ptr().load(std::memory_order_acquire);
+      if (c) {
+        for (auto &sink : c->sinks) {
+          if (sink->should_log(msg.level))
+            guarded_([&] { sink->log(msg); });
+        }
+      }
+    }
+    if (should_flush_(msg))
+      flush_();
+  }
+
+  void flush_() override {
+    detail::epoch_guard guard;
+    const config *c = detail::config_ptr().load(std::memory_order_acquire);
+    if (!c)
+      return;
+    for (auto &sink : c->sinks)
+      guarded_([&] { sink->flush(); });
+  }
+
+private:
+  // Sink failures go to the logger's error handler, as in spdlog::logger.
+  template <class F> void guarded_(F &&f) {
+#ifndef SPDLOG_NO_EXCEPTIONS
+    try {
+      f();
+    } catch (const std::exception &ex) {
+      err_handler_(ex.what());
+    }
+#else
+    f();
+#endif
+  }
+};
+
+// Copy of the current snapshot; before init(), the defaults with the caps
+// set_max_depth() stored so far.
+inline config current_config() {
+  detail::epoch_guard guard;
+  const config *c = detail::config_ptr().load(std::memory_order_acquire);
+  return c ? *c : detail::initial_config();
+}
+
+// Publish a new snapshot, replacing the whole configuration (depth caps
+// included). Levels and depth caps go to their atomics; patterns are picked
+// up by config_formatter on the next record.
+inline void apply_config(config c) {
+  std::lock_guard<std::mutex> lock(detail::config_write_mutex());
+  detail::publish_config(std::move(c));
+}
+
+// Depth cap of one level. Once a config snapshot exists (init()), this
+// publishes one with the new cap, so later reloads keep it unless they set
+// that max_depth key themselves; before that it only sets the cap, and
+// init() carries it into its first snapshot.
+inline void set_max_depth(spdlog::level::level_enum lvl, int n) {
+  std::lock_guard<std::mutex> lock(detail::config_write_mutex());
+  const config *cur = detail::config_ptr().load(std::memory_order_relaxed);
+  if (!cur) {
+    detail::store_max_depth(lvl, n);
+    return;
+  }
+  config c = *cur;
+  c.max_depth[lvl] = n;
+  detail::publish_config(std::move(c));
+}
+
+// Same cap for every level.
+inline void set_max_depth(int n) {
+  for (int i = 0; i < spdlog::level::n_levels; ++i)
+    set_max_depth(static_cast<spdlog::level::level_enum>(i), n);
+}
+
+namespace detail {
+
+inline std::string_view trim(std::string_view v) {
+  const auto b = v.find_first_not_of(" \t\r\n");
+  if (b == std::string_view::npos)
+    return {};
+  const auto e = v.find_last_not_of(" \t\r\n");
+  return v.substr(b, e - b + 1);
+}
+
+inline spdlog::level::level_enum parse_level(std::string_view v) {
+  if (v == "warn")
+    v = "warning";
+  else if (v == "err")
+    v = "error";
+  for (int i = 0; i < spdlog::level::n_levels; ++i) {
+    const auto lvl = static_cast<spdlog::level::level_enum>(i);
+    const auto name = spdlog::level::to_string_view(lvl);
+    if (v == std::string_view(name.data(), name.size()))
+      return lvl;
+  }
+  spdlog::throw_spdlog_ex("depthlog config: unknown level '" +
+                          std::string(v) + "'");
+}
+
+// One "key = value" (or "key=value") assignment.
+inline void apply_config_entry(config &c, std::string_view entry) {
+  entry = trim(entry);
+  if (entry.empty() || entry.front() == '#')
+    return;
+  const auto eq = entry.find('=');
+  if (eq == std::string_view::npos)
+    spdlog::throw_spdlog_ex("depthlog config: expected key=value, got '" +
+                            std::string(entry) + "'");
+  const auto key = trim(entry.substr(0, eq));
+  const auto value = trim(entry.substr(eq + 1));
+
+  if (key == "level") {
+    c.level = parse_level(value);
+  } else if (key == "flush_level") {
+    c.flush_level = parse_level(value);
+  } else if (key == "file_pattern") {
+    c.file_pattern = std::string(value);
+    c.formatter = nullptr;
+  } else if (key == "stderr_pattern") {
+    c.stderr_pattern = std::string(value);
+    c.formatter = nullptr;
+  } else if (key.substr(0, 9) == "max_depth") {
+    const int n = value == "none" ? INT_MAX : std::stoi(std::string(value));
+    if (key == "max_depth")
+      c.max_depth.fill(n);
+    else if (key.size() > 10 && key[9] == '.')
+      c.max_depth[parse_level(key.substr(10))] = n;
+    else
+      spdlog::throw_spdlog_ex("depthlog config: unknown key '" +
+                              std::string(key) + "'");
+  } else {
+    spdlog::throw_spdlog_ex("depthlog config: unknown key '" +
+                            std::string(key) + "'");
+  }
+}
+
+} // namespace detail
+
+// Reload from a file of "key = value" lines ('#' comments). Keys: level,
+// flush_level, max_depth, max_depth.<level>, file_pattern, stderr_pattern.
+// Unspecified keys keep their current values. Throws spdlog_ex on errors,
+// in which case nothing is applied.
+inline void reload_config_file(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    spdlog::throw_spdlog_ex("depthlog config: cannot open " + path, errno);
+  detail::update_config([&](config &c) {
+    std::string line;
+    while (std::getline(in, line))
+      detail::apply_config_entry(c, line);
+  });
+}
+
+// Same keys from an environment variable, ';'-separated, e.g.
+//   DEPTHLOG_CONFIG="level=debug;max_depth.debug=4"
+// Returns false if the variable is unset.
+inline bool reload_config_env(const char *var = "DEPTHLOG_CONFIG") {
+  const char *env = std::getenv(var);
+  if (!env)
+    return false;
+  detail::update_config([env](config &c) {
+    std::string_view rest(env);
+    while (!rest.empty()) {
+      const auto semi = rest.find(';');
+      detail::apply_config_entry(c, rest.substr(0, semi));
+      rest = semi == std::string_view::npos ? std::string_view{}
+                                            : rest.substr(semi + 1);
+    }
+  });
+  return true;
+}
+
+// Optional pipeline features for init().
+struct options {
+  // Collapse consecutive identical records per thread (see dedup_sink).
+  // Summaries of threads gone idle are written on a flush; with no other
+  // flushing, spdlog::flush_every() bounds how long they wait.
+  bool dedup = false;
+  // One file per thread instead of a shared one (thread_sharded_file_sink):
+  // "<prefix>_YYYYmmdd_HHMMSS.tid-<n>.log".
+  bool shard_per_thread = false;
+  // Segment size/age limits, retention and compression of the log files.
+  rotation_policy rotation;
+  // Preallocation and page cache drop-behind for the log files.
+  io_policy io;
+};
+
+inline void init(const std::string &log_file_prefix,
+                 const options &opts = options{}) {
+  std::shared_ptr<spdlog::sinks::sink> file_sink;
+  if (opts.shard_per_thread)
+    file_sink = std::make_shared<thread_sharded_file_sink>(
+        depthlog::make_log_stem(log_file_prefix), opts.rotation, opts.io);
+  else
+    file_sink = std::make_shared<indexed_file_sink_mt>(
+        depthlog::make_log_filename(log_file_prefix), opts.rotation,
+        opts.io);
+  // Per-sink formatters follow the config snapshot's patterns.
+  file_sink->set_formatter(spdlog::details::make_unique<config_formatter>(
+      config_formatter::role::file));
 
   auto stderr_sink = std::make_shared<depthlog::stderr_indent_color_sink_mt>(4);
+  stderr_sink->set_formatter(spdlog::details::make_unique<config_formatter>(
+      config_formatter::role::console));
 
-  stderr_sink->set_pattern(R"(%H:%M:%S [%^%1!L%$] %20s:%-6# | %v)");
+  // Keeps what was set before (e.g. set_max_depth() caps); replaces sinks.
+  config c = current_config();
+  c.sinks = {file_sink, stderr_sink};
+  if (opts.dedup)
+    c.sinks = {std::make_shared<dedup_sink_mt>(std::move(c.sinks))};
 
-  auto lg = std::make_shared<spdlog::logger>(
-      "main", spdlog::sinks_init_list{file_sink, stderr_sink});
-  spdlog::set_default_logger(lg);
+  spdlog::set_default_logger(std::make_shared<depthlog::logger>("main"));
+  apply_config(std::move(c));
+}
 
-  spdlog::set_level(spdlog::level::info);
-  spdlog::flush_on(spdlog::level::info);
+// Per-call-site rate limiting state for the *_EVERY_N / *_FIRST_N /
+// *_EVERY_MS / *_RATE macros. Each site is a function-local static; the
+// pass/suppress decision is a relaxed atomic (plus a clock read for the
+// time-based ones).
+inline std::int64_t steady_now_ns() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
 }
 
+class every_n_site {
+public:
+  bool should_log(std::uint64_t n) noexcept {
+    return n <= 1 || count_.fetch_add(1, std::memory_order_relaxed) % n == 0;
+  }
+
+private:
+  std::atomic<std::uint64_t> count_{0};
+};
+
+class first_n_site {
+public:
+  bool should_log(std::uint64_t n) noexcept {
+    // Plain load first so a saturated site stops writing the cache line.
+    return count_.load(std::memory_order_relaxed) < n &&
+           count_.fetch_add(1, std::memory_order_relaxed) < n;
+  }
+
+private:
+  std::atomic<std::uint64_t> count_{0};
+};
+
+// Shared suppression counter for the time-based sites. should_log() reports
+// how many calls were dropped since the last one that passed.
+class suppressing_site {
+protected:
+  bool suppress_() noexcept {
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  bool pass_(std::uint64_t &suppressed) noexcept {
+    suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    return true;
+  }
+
+private:
+  std::atomic<std::uint64_t> suppressed_{0};
+};
+
+class every_ms_site : public suppressing_site {
+public:
+  bool should_log(std::int64_t ms, std::uint64_t &suppressed) noexcept {
+    const auto now = steady_now_ns();
+    auto next = next_ns_.load(std::memory_order_relaxed);
+    if (now < next ||
+        !next_ns_.compare_exchange_strong(next, now + ms * 1000000,
+                                          std::memory_order_relaxed))
+      return suppress_();
+    return pass_(suppressed);
+  }
+
+private:
+  std::atomic<std::int64_t> next_ns_{0};
+};
+
+// Token bucket as GCRA: one atomic "theoretical arrival time".
+// Allows `burst` back-to-back calls, refilling at `per_sec`. per_sec <= 0
+// (or NaN) never logs, burst < 1 counts as 1; rates above 1e9/s do not
+// limit. The interval (kMaxIntervalNs) and the burst window (kMaxWindowNs)
+// are capped so that no input overflows the arithmetic.
+class token_bucket_site : public suppressing_site {
+public:
+  static constexpr double kMaxIntervalNs = 1e17; // ~3 years
+  static constexpr double kMaxWindowNs = 4e18;
+
+  bool should_log(double per_sec, std::int64_t burst,
+                  std::uint64_t &suppressed) noexcept {
+    if (!(per_sec > 0))
+      return suppress_();
+    const double interval_ns = std::min(1e9 / per_sec, kMaxIntervalNs);
+    const double extra = burst > 1 ? static_cast<double>(burst - 1) : 0;
+    const auto interval = static_cast<std::int64_t>(interval_ns);
+    const auto tolerance =
+        static_cast<std::int64_t>(std::min(interval_ns * extra, kMaxWindowNs));
+    const auto now = steady_now_ns();
+    auto tat = tat_.load(std::memory_order_relaxed);
+    for (;;) {
+      if (tat - now > tolerance)
+        return suppress_();
+      const auto next = (tat > now ? tat : now) + interval;
+      if (tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed))
+        return pass_(suppressed);
+    }
+  }
+
+private:
+  std::atomic<std::int64_t> tat_{0};
+};
+
 } // namespace depthlog
 
+#define DEPTHLOG_CONCAT_(a, b) a##b
+#define DEPTHLOG_CONCAT(a, b) DEPTHLOG_CONCAT_(a, b)
+
+// Scopes only matter if some level at or above DEPTHLOG_SCOPE_MIN_LEVEL can
+// be logged. Below that (and always with DEPTHLOG_ENABLE=OFF, where the
+// active level is OFF) DEPTHLOG_SCOPE() expands to nothing: no Scope object
+// and no TLS access. Define e.g. -DDEPTHLOG_SCOPE_MIN_LEVEL=SPDLOG_LEVEL_DEBUG
+// to keep depth bookkeeping only in builds that compile debug logs in.
+#ifndef DEPTHLOG_SCOPE_MIN_LEVEL
+#define DEPTHLOG_SCOPE_MIN_LEVEL SPDLOG_LEVEL_CRITICAL
+#endif
+
 // RAII scope helper
-#define DEPTHLOG_SCOPE() ::depthlog::Scope depthlog_scope_##__LINE__
+#if SPDLOG_ACTIVE_LEVEL <= DEPTHLOG_SCOPE_MIN_LEVEL
+#define DEPTHLOG_SCOPE()                                                       \
+  ::depthlog::Scope DEPTHLOG_CONCAT(depthlog_scope_, __LINE__)
+#else
+#define DEPTHLOG_SCOPE() static_cast<void>(0)
+#endif
 
 // LOG MACROs
-#define DEPTHLOG_TRACE(...) SPDLOG_TRACE(__VA_ARGS__)
-#define DEPTHLOG_DEBUG(...) SPDLOG_DEBUG(__VA_ARGS__)
-#define DEPTHLOG_INFO(...) SPDLOG_INFO(__VA_ARGS__)
-#define DEPTHLOG_WARN(...) SPDLOG_WARN(__VA_ARGS__)
-#define DEPTHLOG_ERROR(...) SPDLOG_ERROR(__VA_ARGS__)
-#define DEPTHLOG_CRITICAL(...) SPDLOG_CRITICAL(__VA_ARGS__)
+// Each checks the per-level depth cap first; see set_max_depth().
+#define DEPTHLOG_LOG_(lvl, LOG, ...)                                           \
+  (::depthlog::depth_allowed(lvl) ? LOG(__VA_ARGS__) : (void)0)
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
+#define DEPTHLOG_TRACE(...)                                                    \
+  DEPTHLOG_LOG_(spdlog::level::trace, SPDLOG_TRACE, __VA_ARGS__)
+#else
+#define DEPTHLOG_TRACE(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define DEPTHLOG_DEBUG(...)                                                    \
+  DEPTHLOG_LOG_(spdlog::level::debug, SPDLOG_DEBUG, __VA_ARGS__)
+#else
+#define DEPTHLOG_DEBUG(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_INFO
+#define DEPTHLOG_INFO(...)                                                     \
+  DEPTHLOG_LOG_(spdlog::level::info, SPDLOG_INFO, __VA_ARGS__)
+#else
+#define DEPTHLOG_INFO(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_WARN
+#define DEPTHLOG_WARN(...)                                                     \
+  DEPTHLOG_LOG_(spdlog::level::warn, SPDLOG_WARN, __VA_ARGS__)
+#else
+#define DEPTHLOG_WARN(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_ERROR
+#define DEPTHLOG_ERROR(...)                                                    \
+  DEPTHLOG_LOG_(spdlog::level::err, SPDLOG_ERROR, __VA_ARGS__)
+#else
+#define DEPTHLOG_ERROR(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_CRITICAL
+#define DEPTHLOG_CRITICAL(...)                                                 \
+  DEPTHLOG_LOG_(spdlog::level::critical, SPDLOG_CRITICAL, __VA_ARGS__)
+#else
+#define DEPTHLOG_CRITICAL(...) (void)0
+#endif
+
+// Rate-limited variants, e.g. DEPTHLOG_WARN_EVERY_N(100, "retry {}", i).
+// The time-based ones emit "suppressed K messages" from the same site
+// before the first message that passes after a dropped stretch.
+// *_RATE(per_sec, burst, ...) accepts any values, e.g. from a config file:
+// per_sec <= 0 suppresses the site entirely, burst <= 0 means 1.
+#define DEPTHLOG_EVERY_N_(LOG, n, ...)                                         \
+  do {                                                                         \
+    static ::depthlog::every_n_site depthlog_site_;                            \
+    if (depthlog_site_.should_log(n))                                          \
+      LOG(__VA_ARGS__);                                                        \
+  } while (0)
+
+#define DEPTHLOG_FIRST_N_(LOG, n, ...)                                         \
+  do {                                                                         \
+    static ::depthlog::first_n_site depthlog_site_;                            \
+    if (depthlog_site_.should_log(n))                                          \
+      LOG(__VA_ARGS__);                                                        \
+  } while (0)
+
+#define DEPTHLOG_EVERY_MS_(LOG, ms, ...)                                       \
+  do {                                                                         \
+    static ::depthlog::every_ms_site depthlog_site_;                           \
+    std::uint64_t depthlog_suppressed_ = 0;                                    \
+    if (depthlog_site_.should_log(ms, depthlog_suppressed_)) {                 \
+      if (depthlog_suppressed_)                                                \
+        LOG("suppressed {} messages", depthlog_suppressed_);                   \
+      LOG(__VA_ARGS__);                                                        \
+    }                                                                          \
+  } while (0)
+
+#define DEPTHLOG_RATE_(LOG, per_sec, burst, ...)                               \
+  do {                                                                         \
+    static ::depthlog::token_bucket_site depthlog_site_;                       \
+    std::uint64_t depthlog_suppressed_ = 0;                                    \
+    if (depthlog_site_.should_log(per_sec, burst, depthlog_suppressed_)) {     \
+      if (depthlog_suppressed_)                                                \
+        LOG("suppressed {} messages", depthlog_suppressed_);                   \
+      LOG(__VA_ARGS__);                                                        \
+    }                                                                          \
+  } while (0)
+
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
+#define DEPTHLOG_TRACE_EVERY_N(n, ...)                                         \
+  DEPTHLOG_EVERY_N_(DEPTHLOG_TRACE, n, __VA_ARGS__)
+#define DEPTHLOG_TRACE_FIRST_N(n, ...)                                         \
+  DEPTHLOG_FIRST_N_(DEPTHLOG_TRACE, n, __VA_ARGS__)
+#define DEPTHLOG_TRACE_EVERY_MS(ms, ...)                                       \
+  DEPTHLOG_EVERY_MS_(DEPTHLOG_TRACE, ms, __VA_ARGS__)
+#define DEPTHLOG_TRACE_RATE(per_sec, burst, ...)                               \
+  DEPTHLOG_RATE_(DEPTHLOG_TRACE, per_sec, burst, __VA_ARGS__)
+#else
+#define DEPTHLOG_TRACE_EVERY_N(...) (void)0
+#define DEPTHLOG_TRACE_FIRST_N(...) (void)0
+#define DEPTHLOG_TRACE_EVERY_MS(...) (void)0
+#define DEPTHLOG_TRACE_RATE(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define DEPTHLOG_DEBUG_EVERY_N(n, ...)                                         \
+  DEPTHLOG_EVERY_N_(DEPTHLOG_DEBUG, n, __VA_ARGS__)
+#define DEPTHLOG_DEBUG_FIRST_N(n, ...)                                         \
+  DEPTHLOG_FIRST_N_(DEPTHLOG_DEBUG, n, __VA_ARGS__)
+#define DEPTHLOG_DEBUG_EVERY_MS(ms, ...)                                       \
+  DEPTHLOG_EVERY_MS_(DEPTHLOG_DEBUG, ms, __VA_ARGS__)
+#define DEPTHLOG_DEBUG_RATE(per_sec, burst, ...)                               \
+  DEPTHLOG_RATE_(DEPTHLOG_DEBUG, per_sec, burst, __VA_ARGS__)
+#else
+#define DEPTHLOG_DEBUG_EVERY_N(...) (void)0
+#define DEPTHLOG_DEBUG_FIRST_N(...) (void)0
+#define DEPTHLOG_DEBUG_EVERY_MS(...) (void)0
+#define DEPTHLOG_DEBUG_RATE(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_INFO
+#define DEPTHLOG_INFO_EVERY_N(n, ...)                                          \
+  DEPTHLOG_EVERY_N_(DEPTHLOG_INFO, n, __VA_ARGS__)
+#define DEPTHLOG_INFO_FIRST_N(n, ...)                                          \
+  DEPTHLOG_FIRST_N_(DEPTHLOG_INFO, n, __VA_ARGS__)
+#define DEPTHLOG_INFO_EVERY_MS(ms, ...)                                        \
+  DEPTHLOG_EVERY_MS_(DEPTHLOG_INFO, ms, __VA_ARGS__)
+#define DEPTHLOG_INFO_RATE(per_sec, burst, ...)                                \
+  DEPTHLOG_RATE_(DEPTHLOG_INFO, per_sec, burst, __VA_ARGS__)
+#else
+#define DEPTHLOG_INFO_EVERY_N(...) (void)0
+#define DEPTHLOG_INFO_FIRST_N(...) (void)0
+#define DEPTHLOG_INFO_EVERY_MS(...) (void)0
+#define DEPTHLOG_INFO_RATE(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_WARN
+#define DEPTHLOG_WARN_EVERY_N(n, ...)                                          \
+  DEPTHLOG_EVERY_N_(DEPTHLOG_WARN, n, __VA_ARGS__)
+#define DEPTHLOG_WARN_FIRST_N(n, ...)                                          \
+  DEPTHLOG_FIRST_N_(DEPTHLOG_WARN, n, __VA_ARGS__)
+#define DEPTHLOG_WARN_EVERY_MS(ms, ...)                                        \
+  DEPTHLOG_EVERY_MS_(DEPTHLOG_WARN, ms, __VA_ARGS__)
+#define DEPTHLOG_WARN_RATE(per_sec, burst, ...)                                \
+  DEPTHLOG_RATE_(DEPTHLOG_WARN, per_sec, burst, __VA_ARGS__)
+#else
+#define DEPTHLOG_WARN_EVERY_N(...) (void)0
+#define DEPTHLOG_WARN_FIRST_N(...) (void)0
+#define DEPTHLOG_WARN_EVERY_MS(...) (void)0
+#define DEPTHLOG_WARN_RATE(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_ERROR
+#define DEPTHLOG_ERROR_EVERY_N(n, ...)                                         \
+  DEPTHLOG_EVERY_N_(DEPTHLOG_ERROR, n, __VA_ARGS__)
+#define DEPTHLOG_ERROR_FIRST_N(n, ...)                                         \
+  DEPTHLOG_FIRST_N_(DEPTHLOG_ERROR, n, __VA_ARGS__)
+#define DEPTHLOG_ERROR_EVERY_MS(ms, ...)                                       \
+  DEPTHLOG_EVERY_MS_(DEPTHLOG_ERROR, ms, __VA_ARGS__)
+#define DEPTHLOG_ERROR_RATE(per_sec, burst, ...)                               \
+  DEPTHLOG_RATE_(DEPTHLOG_ERROR, per_sec, burst, __VA_ARGS__)
+#else
+#define DEPTHLOG_ERROR_EVERY_N(...) (void)0
+#define DEPTHLOG_ERROR_FIRST_N(...) (void)0
+#define DEPTHLOG_ERROR_EVERY_MS(...) (void)0
+#define DEPTHLOG_ERROR_RATE(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_CRITICAL
+#define DEPTHLOG_CRITICAL_EVERY_N(n, ...)                                      \
+  DEPTHLOG_EVERY_N_(DEPTHLOG_CRITICAL, n, __VA_ARGS__)
+#define DEPTHLOG_CRITICAL_FIRST_N(n, ...)                                      \
+  DEPTHLOG_FIRST_N_(DEPTHLOG_CRITICAL, n, __VA_ARGS__)
+#define DEPTHLOG_CRITICAL_EVERY_MS(ms, ...)                                    \
+  DEPTHLOG_EVERY_MS_(DEPTHLOG_CRITICAL, ms, __VA_ARGS__)
+#define DEPTHLOG_CRITICAL_RATE(per_sec, burst, ...)                            \
+  DEPTHLOG_RATE_(DEPTHLOG_CRITICAL, per_sec, burst, __VA_ARGS__)
+#else
+#define DEPTHLOG_CRITICAL_EVERY_N(...) (void)0
+#define DEPTHLOG_CRITICAL_FIRST_N(...) (void)0
+#define DEPTHLOG_CRITICAL_EVERY_MS(...) (void)0
+#define DEPTHLOG_CRITICAL_RATE(...) (void)0
+#endif
@@ -0,0 +1,141 @@
+#pragma once
+
+// Minimal epoch-based reclamation for read-mostly snapshots.
+//
+// Readers bracket access with enter()/exit() (or epoch_guard): one load,
+// one store and a fence, never a lock. Writers publish a new pointer, then
+// retire() the old one; it is deleted once every reader that could still
+// see it has left its critical section.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace depthlog {
+namespace detail {
+
+class epoch_domain {
+public:
+  static constexpr std::size_t kSlots = 128;
+  static constexpr std::uint64_t kIdle = ~std::uint64_t{0};
+
+  static epoch_domain &instance() {
+    static epoch_domain d;
+    return d;
+  }
+
+  void enter() noexcept {
+    reader &r = reader_();
+    if (r.nesting++ != 0)
+      return;
+    const auto e = epoch_.load(std::memory_order_acquire);
+    if (r.slot)
+      r.slot->store(e, std::memory_order_relaxed);
+    else
+      overflow_.fetch_add(1, std::memory_order_relaxed);
+    // Pairs with the fence in reclaim_(): either the writer sees this
+    // slot, or this reader sees the writer's new pointer.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  void exit() noexcept {
+    reader &r = reader_();
+    if (--r.nesting != 0)
+      return;
+    if (r.slot)
+      r.slot->store(kIdle, std::memory_order_release);
+    else
+      overflow_.fetch_sub(1, std::memory_order_release);
+  }
+
+  // Call after the old object has been unpublished.
+  void retire(std::function<void()> deleter) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto e = epoch_.fetch_add(1, std::memory_order_seq_cst);
+    retired_.emplace_back(e, std::move(deleter));
+    reclaim_();
+  }
+
+  // Frees whatever is safe now; retire() also does this.
+  void reclaim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reclaim_();
+  }
+
+private:
+  struct slot_t {
+    std::atomic<bool> used{false};
+    alignas(64) std::atomic<std::uint64_t> epoch{kIdle};
+  };
+
+  // Per-thread registration; threads past kSlots share a counter that
+  // defers reclamation while any of them is inside.
+  struct reader {
+    explicit reader(epoch_domain &d) : domain(d) {
+      for (auto &s : d.slots_) {
+        bool expected = false;
+        if (s.used.compare_exchange_strong(expected, true)) {
+          owner = &s;
+          slot = &s.epoch;
+          break;
+        }
+      }
+    }
+    ~reader() {
+      if (owner)
+        owner->used.store(false, std::memory_order_release);
+    }
+
+    epoch_domain &domain;
+    slot_t *owner = nullptr;
+    std::atomic<std::uint64_t> *slot = nullptr;
+    int nesting = 0;
+  };
+
+  reader &reader_() noexcept {
+    thread_local reader r(*this);
+    return r;
+  }
+
+  void reclaim_() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (overflow_.load(std::memory_order_acquire) != 0)
+      return;
+    std::uint64_t oldest = kIdle;
+    for (auto &s : slots_) {
+      const auto e = s.epoch.load(std::memory_order_acquire);
+      if (e < oldest)
+        oldest = e;
+    }
+    auto keep = retired_.begin();
+    for (auto it = retired_.begin(); it != retired_.end(); ++it) {
+      if (it->first < oldest)
+        it->second();
+      else
+        *keep++ = std::move(*it);
+    }
+    retired_.erase(keep, retired_.end());
+  }
+
+  std::atomic<std::uint64_t> epoch_{0};
+  std::atomic<std::size_t> overflow_{0};
+  slot_t slots_[kSlots];
+  std::mutex mutex_;
+  std::vector<std::pair<std::uint64_t, std::function<void()>>> retired_;
+};
+
+// RAII read-side critical section.
+class epoch_guard {
+public:
+  epoch_guard() noexcept { epoch_domain::instance().enter(); }
+  epoch_guard(const epoch_guard &) = delete;
+  epoch_guard &operator=(const epoch_guard &) = delete;
+  ~epoch_guard() { epoch_domain::instance().exit(); }
+};
+
+} // namespace detail
+} // namespace depthlog
@@ -0,0 +1,190 @@
+#pragma once
+
+// Built-in compressor for rotated log segments: the LZ4 frame format
+// (https://github.com/lz4/lz4/blob/dev/doc/lz4_Frame_format.md), so the
+// output reads back with a stock `lz4 -d` or any LZ4 library.
+//
+// Independent 4 MiB blocks, no checksums, greedy single-probe matching:
+// roughly LZ4's fast mode. depthlog logs are repetitive enough that this
+// gets around 10x at several hundred MB/s per core. No dependencies beyond
+// the standard library and stdio.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace depthlog {
+namespace detail {
+namespace lz4 {
+
+inline constexpr std::size_t kBlockSize = std::size_t{4} << 20;
+
+inline std::uint32_t read32(const std::uint8_t *p) noexcept {
+  std::uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+
+inline void write32le(std::uint8_t *p, std::uint32_t v) noexcept {
+  p[0] = static_cast<std::uint8_t>(v);
+  p[1] = static_cast<std::uint8_t>(v >> 8);
+  p[2] = static_cast<std::uint8_t>(v >> 16);
+  p[3] = static_cast<std::uint8_t>(v >> 24);
+}
+
+// XXH32, needed for the frame header checksum.
+inline std::uint32_t xxh32(const std::uint8_t *p, std::size_t n,
+                           std::uint32_t seed = 0) noexcept {
+  constexpr std::uint32_t p1 = 2654435761u, p2 = 2246822519u,
+                          p3 = 3266489917u, p4 = 668265263u, p5 = 374761393u;
+  const auto rotl = [](std::uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+  };
+  const auto round = [&](std::uint32_t acc, std::uint32_t in) {
+    return rotl(acc + in * p2, 13) * p1;
+  };
+  const std::uint8_t *const end = p + n;
+  std::uint32_t h;
+  if (n >= 16) {
+    std::uint32_t v1 = seed + p1 + p2, v2 = seed + p2, v3 = seed,
+                  v4 = seed - p1;
+    for (; p + 16 <= end; p += 16) {
+      v1 = round(v1, read32(p));
+      v2 = round(v2, read32(p + 4));
+      v3 = round(v3, read32(p + 8));
+      v4 = round(v4, read32(p + 12));
+    }
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+  } else {
+    h = seed + p5;
+  }
+  h += static_cast<std::uint32_t>(n);
+  for (; p + 4 <= end; p += 4)
+    h = rotl(h + read32(p) * p3, 17) * p4;
+  for (; p < end; ++p)
+    h = rotl(h + *p * p5, 11) * p1;
+  h ^= h >> 15;
+  h *= p2;
+  h ^= h >> 13;
+  h *= p3;
+  h ^= h >> 16;
+  return h;
+}
+
+inline std::size_t block_bound(std::size_t n) noexcept {
+  return n + n / 255 + 16;
+}
+
+// Compresses src[0, n) into one LZ4 block at dst (block_bound(n) bytes);
+// returns the compressed size. table must hold 1 << 16 entries.
+inline std::size_t compress_block(const std::uint8_t *src, std::size_t n,
+                                  std::uint8_t *dst,
+                                  std::uint32_t *table) noexcept {
+  constexpr std::size_t kMinMatch = 4;
+  constexpr std::size_t kLastLiterals = 5; // format: trailing literals
+  constexpr std::size_t kMfLimit = 12;     // format: no match starts after
+  std::memset(table, 0, sizeof(std::uint32_t) << 16);
+
+  std::uint8_t *op = dst;
+  const auto put_len = [&](std::size_t len) {
+    for (; len >= 255; len -= 255)
+      *op++ = 255;
+    *op++ = static_cast<std::uint8_t>(len);
+  };
+  const auto put_literals = [&](const std::uint8_t *lit, std::size_t len,
+                                std::uint8_t match_nibble) {
+    std::uint8_t *token = op++;
+    *token = static_cast<std::uint8_t>((len >= 15 ? 15 : len) << 4 |
+                                       match_nibble);
+    if (len >= 15)
+      put_len(len - 15);
+    std::memcpy(op, lit, len);
+    op += len;
+  };
+
+  const std::uint8_t *ip = src, *anchor = src;
+  const std::uint8_t *const end = src + n;
+  if (n > kMfLimit) {
+    const std::uint8_t *const mflimit = end - kMfLimit;
+    const std::uint8_t *const matchlimit = end - kLastLiterals;
+    while (ip < mflimit) {
+      const std::uint32_t seq = read32(ip);
+      const std::uint32_t h = (seq * 2654435761u) >> 16;
+      const std::uint32_t prev = table[h]; // position + 1, 0 = empty
+      table[h] = static_cast<std::uint32_t>(ip - src) + 1;
+      const std::uint8_t *ref = src + prev - 1;
+      if (prev == 0 || ip - ref > 65535 || read32(ref) != seq) {
+        ++ip;
+        continue;
+      }
+      const std::uint8_t *mp = ip + kMinMatch, *mr = ref + kMinMatch;
+      while (mp < matchlimit && *mp == *mr) {
+        ++mp;
+        ++mr;
+      }
+      const std::size_t ml = static_cast<std::size_t>(mp - ip) - kMinMatch;
+      put_literals(anchor, static_cast<std::size_t>(ip - anchor),
+                   static_cast<std::uint8_t>(ml >= 15 ? 15 : ml));
+      const auto off = static_cast<std::uint16_t>(ip - ref);
+      *op++ = static_cast<std::uint8_t>(off);
+      *op++ = static_cast<std::uint8_t>(off >> 8);
+      if (ml >= 15)
+        put_len(ml - 15);
+      ip = anchor = mp;
+    }
+  }
+  put_literals(anchor, static_cast<std::size_t>(end - anchor), 0);
+  return static_cast<std::size_t>(op - dst);
+}
+
+// Compresses the file at src into an LZ4 frame at dst. False on any I/O
+// error (dst is then removed).
+inline bool compress_file(const std::string &src, const std::string &dst) {
+  std::FILE *in = std::fopen(src.c_str(), "rb");
+  if (!in)
+    return false;
+  std::FILE *out = std::fopen(dst.c_str(), "wb");
+  if (!out) {
+    std::fclose(in);
+    return false;
+  }
+
+  // Magic, FLG (version 01, independent blocks), BD (4 MiB blocks), HC.
+  std::uint8_t header[7] = {0x04, 0x22, 0x4d, 0x18, 0x60, 0x70, 0};
+  header[6] = static_cast<std::uint8_t>(xxh32(header + 4, 2) >> 8);
+  bool ok = std::fwrite(header, 1, sizeof header, out) == sizeof header;
+
+  std::vector<std::uint8_t> block(kBlockSize);
+  std::vector<std::uint8_t> packed(4 + block_bound(kBlockSize));
+  std::vector<std::uint32_t> table(std::size_t{1} << 16);
+  while (ok) {
+    const std::size_t n = std::fread(block.data(), 1, block.size(), in);
+    if (n == 0) {
+      ok = !std::ferror(in);
+      break;
+    }
+    std::size_t len =
+        compress_block(block.data(), n, packed.data() + 4, table.data());
+    std::uint32_t size_field = static_cast<std::uint32_t>(len);
+    if (len >= n) { // incompressible: store as is (high bit set)
+      std::memcpy(packed.data() + 4, block.data(), n);
+      len = n;
+      size_field = static_cast<std::uint32_t>(n) | 0x80000000u;
+    }
+    write32le(packed.data(), size_field);
+    ok = std::fwrite(packed.data(), 1, 4 + len, out) == 4 + len;
+  }
+  const std::uint8_t end_mark[4] = {0, 0, 0, 0};
+  ok = ok && std::fwrite(end_mark, 1, 4, out) == 4;
+  std::fclose(in);
+  ok = std::fclose(out) == 0 && ok;
+  if (!ok)
+    std::remove(dst.c_str());
+  return ok;
+}
+
+} // namespace lz4
+} // namespace detail
+} // namespace depthlog
@@ -0,0 +1,240 @@
+#pragma once
+
+// Per-site latency histograms for timed scopes.
+//
+//   void handle() {
+//     DEPTHLOG_TIMED_SCOPE("handle");
+//     ...
+//   }
+//
+// Each DEPTHLOG_TIMED_SCOPE() site owns a static latency_site: fixed-size
+// log-linear buckets (HDR-style, ~6% relative error) sharded by thread
+// index. Recording is a relaxed fetch_add on the caller's shard; readers
+// merge the shards. Nothing allocates after the site is constructed.
+
+#include <depthlog/depthlog.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace depthlog {
+
+class histogram_snapshot;
+
+class latency_site {
+public:
+  // 2^kSubBits linear sub-buckets per power of two.
+  static constexpr int kSubBits = 4;
+  static constexpr std::uint64_t kSubCount = std::uint64_t{1} << kSubBits;
+  // Values (ns) are clamped below 2^kMaxBits (~4.9 hours).
+  static constexpr int kMaxBits = 44;
+  static constexpr std::size_t kBuckets =
+      static_cast<std::size_t>(kMaxBits - kSubBits + 1) * kSubCount;
+  static constexpr std::size_t kShards = 8;
+
+  latency_site(const char *name, const char *file, int line)
+      : name_(name), file_(file), line_(line) {
+    next_ = head().load(std::memory_order_relaxed);
+    while (!head().compare_exchange_weak(next_, this,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {
+    }
+  }
+  latency_site(const latency_site &) = delete;
+  latency_site &operator=(const latency_site &) = delete;
+
+  void record(std::uint64_t ns) noexcept {
+    shard &s = shards_[thread_index() % kShards];
+    s.buckets[bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+    std::uint64_t cur = s.max.load(std::memory_order_relaxed);
+    while (ns > cur && !s.max.compare_exchange_weak(
+                           cur, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  inline histogram_snapshot snapshot() const;
+
+  const char *name() const noexcept { return name_; }
+  const char *file() const noexcept { return file_; }
+  int line() const noexcept { return line_; }
+  const latency_site *next() const noexcept { return next_; }
+
+  // Intrusive list of every site constructed so far.
+  static const latency_site *first() noexcept {
+    return head().load(std::memory_order_acquire);
+  }
+
+  static constexpr std::size_t bucket_index(std::uint64_t v) noexcept {
+    if (v >= (std::uint64_t{1} << kMaxBits))
+      v = (std::uint64_t{1} << kMaxBits) - 1;
+    if (v < kSubCount)
+      return static_cast<std::size_t>(v);
+    int msb = 63;
+    while (!(v >> msb))
+      --msb;
+    const int shift = msb - kSubBits;
+    return static_cast<std::size_t>(shift + 1) * kSubCount +
+           static_cast<std::size_t>((v >> shift) - kSubCount);
+  }
+
+  // Highest value that maps to bucket i.
+  static constexpr std::uint64_t bucket_upper(std::size_t i) noexcept {
+    if (i < kSubCount)
+      return i;
+    const int shift = static_cast<int>(i / kSubCount) - 1;
+    const std::uint64_t top = kSubCount + i % kSubCount;
+    return ((top + 1) << shift) - 1;
+  }
+
+private:
+  struct alignas(64) shard {
+    std::array<std::atomic<std::uint64_t>, kBuckets> buckets{};
+    std::atomic<std::uint64_t> max{0};
+  };
+
+  static std::atomic<latency_site *> &head() noexcept {
+    static std::atomic<latency_site *> h{nullptr};
+    return h;
+  }
+
+  const char *name_;
+  const char *file_;
+  int line_;
+  latency_site *next_ = nullptr;
+  std::array<shard, kShards> shards_{};
+};
+
+// Shards of one site merged at a point in time.
+class histogram_snapshot {
+public:
+  std::uint64_t count() const noexcept { return count_; }
+  std::uint64_t max() const noexcept { return max_; }
+
+  // q in [0, 1], e.g. 0.999. Returns the bucket's highest value in ns.
+  std::uint64_t percentile(double q) const noexcept {
+    if (count_ == 0)
+      return 0;
+    q = std::min(std::max(q, 0.0), 1.0);
+    auto rank = static_cast<std::uint64_t>(q * static_cast<double>(count_));
+    rank = std::max<std::uint64_t>(rank, 1);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets_.size(); ++i) {
+      seen += buckets_[i];
+      if (seen >= rank)
+        return std::min(latency_site::bucket_upper(i), max_);
+    }
+    return max_;
+  }
+
+private:
+  friend class latency_site;
+
+  std::array<std::uint64_t, latency_site::kBuckets> buckets_{};
+  std::uint64_t count_ = 0;
+  std::uint64_t max_ = 0;
+};
+
+inline histogram_snapshot latency_site::snapshot() const {
+  histogram_snapshot snap;
+  for (const shard &s : shards_) {
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+      const auto n = s.buckets[i].load(std::memory_order_relaxed);
+      snap.buckets_[i] += n;
+      snap.count_ += n;
+    }
+    snap.max_ = std::max(snap.max_, s.max.load(std::memory_order_relaxed));
+  }
+  return snap;
+}
+
+// RAII: records the scope's wall time into a site on exit.
+class timed_scope {
+public:
+  explicit timed_scope(latency_site &site) noexcept
+      : site_(site), start_(std::chrono::steady_clock::now()) {}
+  timed_scope(const timed_scope &) = delete;
+  timed_scope &operator=(const timed_scope &) = delete;
+  ~timed_scope() {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start_)
+                        .count();
+    site_.record(static_cast<std::uint64_t>(ns));
+  }
+
+private:
+  latency_site &site_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Visit every timed-scope site seen so far.
+template <class F> void for_each_latency_site(F &&f) {
+  for (auto *s = latency_site::first(); s; s = s->next())
+    f(*s);
+}
+
+// One summary line per site with at least one sample.
+inline void
+log_latency_summary(spdlog::logger *lg = spdlog::default_logger_raw(),
+                    spdlog::level::level_enum lvl = spdlog::level::info) {
+  if (!lg || !lg->should_log(lvl))
+    return;
+  for_each_latency_site([&](const latency_site &s) {
+    const auto h = s.snapshot();
+    if (h.count() == 0)
+      return;
+    lg->log(spdlog::source_loc{s.file(), s.line(), s.name()}, lvl,
+            "latency site={} count={} p50_ns={} p90_ns={} p99_ns={} "
+            "p999_ns={} max_ns={}",
+            s.name(), h.count(), h.percentile(0.5), h.percentile(0.9),
+            h.percentile(0.99), h.percentile(0.999), h.max());
+  });
+}
+
+// Background thread that calls log_latency_summary() every period.
+class latency_reporter {
+public:
+  explicit latency_reporter(
+      std::chrono::milliseconds period,
+      std::shared_ptr<spdlog::logger> lg = spdlog::default_logger())
+      : logger_(std::move(lg)), thread_([this, period] { run_(period); }) {}
+  latency_reporter(const latency_reporter &) = delete;
+  latency_reporter &operator=(const latency_reporter &) = delete;
+  ~latency_reporter() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+private:
+  void run_(std::chrono::milliseconds period) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, period, [this] { return stop_; }))
+      log_latency_summary(logger_.get());
+  }
+
+  std::shared_ptr<spdlog::logger> logger_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+} // namespace depthlog
+
+// Scope that also feeds a per-site latency histogram.
+#define DEPTHLOG_TIMED_SCOPE(name)                                             \
+  static ::depthlog::latency_site DEPTHLOG_CONCAT(depthlog_site_, __LINE__){  \
+      name, __FILE__, __LINE__};                                               \
+  DEPTHLOG_SCOPE();                                                            \
+  ::depthlog::timed_scope DEPTHLOG_CONCAT(depthlog_timed_, __LINE__) {         \
+    DEPTHLOG_CONCAT(depthlog_site_, __LINE__)                                  \
+  }
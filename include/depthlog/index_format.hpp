@@ -0,0 +1,82 @@
+#pragma once
+
+// On-disk layout of the sidecar index ("<log file>.idx") written by
+// depthlog::indexed_file_sink, shared with the readers in tools/ and
+// depthlog_tree.py. No spdlog dependency.
+//
+// The file is a 16-byte header followed by fixed-size entries, one per
+// block of the log file (a block is a run of whole records, cut once it
+// reaches the sink's block size). All integers are little-endian.
+//
+//   header: char magic[8] = "DLOGIDX1", u32 entry_size, u32 block_size
+//   entry:  u64 offset, u64 length          byte range in the log file
+//           i64 first_ts_ns, i64 last_ts_ns  UTC ns since the epoch
+//           u64 tid_bloom[4]                 256-bit bloom of thread ids
+//           u32 records, i32 max_depth
+//           u32 level_mask                   bit n = spdlog level n seen
+//           u32 reserved
+//
+// Python: struct "<QQqq4QIiII". The tail of the log after the last entry
+// is not indexed yet and must be scanned.
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "depthlog index files are written in host order; little-endian only"
+#endif
+
+namespace depthlog {
+namespace index_format {
+
+inline constexpr char kMagic[8] = {'D', 'L', 'O', 'G', 'I', 'D', 'X', '1'};
+inline constexpr std::size_t kHeaderSize = 16;
+
+struct entry {
+  std::uint64_t offset = 0;
+  std::uint64_t length = 0;
+  std::int64_t first_ts_ns = 0;
+  std::int64_t last_ts_ns = 0;
+  std::uint64_t tid_bloom[4] = {0, 0, 0, 0};
+  std::uint32_t records = 0;
+  std::int32_t max_depth = 0;
+  std::uint32_t level_mask = 0;
+  std::uint32_t reserved = 0;
+};
+static_assert(sizeof(entry) == 80, "index entry layout");
+
+// Two bloom bits per tid, from a 64-bit mix (splitmix64 finalizer).
+inline void tid_bits(std::uint64_t tid, unsigned &a, unsigned &b) noexcept {
+  std::uint64_t z = tid + 0x9e3779b97f4a7c15ull;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  z ^= z >> 31;
+  a = static_cast<unsigned>(z & 255);
+  b = static_cast<unsigned>((z >> 8) & 255);
+}
+
+inline void bloom_add(entry &e, std::uint64_t tid) noexcept {
+  unsigned a, b;
+  tid_bits(tid, a, b);
+  e.tid_bloom[a / 64] |= std::uint64_t{1} << (a % 64);
+  e.tid_bloom[b / 64] |= std::uint64_t{1} << (b % 64);
+}
+
+// False means the block has no record of this tid.
+inline bool bloom_may_contain(const entry &e, std::uint64_t tid) noexcept {
+  unsigned a, b;
+  tid_bits(tid, a, b);
+  return (e.tid_bloom[a / 64] >> (a % 64) & 1) &&
+         (e.tid_bloom[b / 64] >> (b % 64) & 1);
+}
+
+inline void encode_header(char (&out)[kHeaderSize],
+                          std::uint32_t block_size) noexcept {
+  const std::uint32_t entry_size = sizeof(entry);
+  std::memcpy(out, kMagic, 8);
+  std::memcpy(out + 8, &entry_size, 4);
+  std::memcpy(out + 12, &block_size, 4);
+}
+
+} // namespace index_format
+} // namespace depthlog
@@ -0,0 +1,97 @@
+#pragma once
+
+// tools/index.hpp
+//
+// Reader for the sidecar index next to a log file ("<log>.idx", layout in
+// include/depthlog/index_format.hpp), and the byte ranges of a log a
+// reader has to visit given a block filter.
+
+#include "logfmt.hpp"
+
+#include <depthlog/index_format.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace depthlog_tools {
+
+using index_entry = depthlog::index_format::entry;
+
+// Entries of "<log>.idx"; empty if there is no usable index (missing,
+// foreign, or pointing past the end of a log of log_size bytes).
+inline std::vector<index_entry> read_index(const std::string &log_path,
+                                           std::size_t log_size) {
+  std::vector<index_entry> out;
+  std::FILE *f = std::fopen((log_path + ".idx").c_str(), "rb");
+  if (!f)
+    return out;
+  char header[depthlog::index_format::kHeaderSize];
+  std::uint32_t entry_size = 0;
+  if (std::fread(header, 1, sizeof header, f) == sizeof header &&
+      std::memcmp(header, depthlog::index_format::kMagic, 8) == 0)
+    std::memcpy(&entry_size, header + 8, 4);
+  if (entry_size == sizeof(index_entry)) {
+    index_entry e;
+    while (std::fread(&e, sizeof e, 1, f) == 1) {
+      if (e.offset + e.length > log_size) {
+        out.clear(); // rotated or truncated under the index
+        break;
+      }
+      out.push_back(e);
+    }
+  }
+  std::fclose(f);
+  return out;
+}
+
+struct byte_range {
+  std::size_t begin;
+  std::size_t end;
+};
+
+// Ranges of a log that may hold matches: the index blocks accepted by
+// wanted(entry), plus everything the index does not cover (the unindexed
+// tail, gaps). Adjacent ranges are coalesced up to max_range bytes, and
+// unindexed stretches are cut at line boundaries into max_range pieces.
+template <class Wanted>
+std::vector<byte_range> plan_ranges(std::string_view log,
+                                    const std::vector<index_entry> &index,
+                                    Wanted &&wanted,
+                                    std::size_t max_range = 4u << 20) {
+  std::vector<byte_range> out;
+  const auto add = [&](std::size_t b, std::size_t e) {
+    if (b >= e)
+      return;
+    if (!out.empty() && out.back().end == b &&
+        out.back().end - out.back().begin + (e - b) <= max_range) {
+      out.back().end = e;
+      return;
+    }
+    out.push_back({b, e});
+  };
+  const auto add_unindexed = [&](std::size_t b, std::size_t e) {
+    while (b < e) {
+      std::size_t cut = std::min(e, b + max_range);
+      if (cut < e) {
+        const auto nl = log.find('\n', cut);
+        cut = nl == std::string_view::npos ? e : std::min(e, nl + 1);
+      }
+      add(b, cut);
+      b = cut;
+    }
+  };
+
+  std::size_t pos = 0;
+  for (const auto &e : index) {
+    if (e.offset > pos)
+      add_unindexed(pos, e.offset);
+    if (wanted(e))
+      add(e.offset, e.offset + e.length);
+    pos = std::max<std::size_t>(pos, e.offset + e.length);
+  }
+  add_unindexed(pos, log.size());
+  return out;
+}
+
+} // namespace depthlog_tools
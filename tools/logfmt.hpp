@@ -0,0 +1,240 @@
+#pragma once
+
+// tools/logfmt.hpp
+//
+// Shared helpers for the standalone depthlog tools: read-only mmap'd input
+// files and a zero-copy reader for the logfmt lines written with
+// depthlog::kLogfmtPattern:
+//
+//   ts="2026-01-05T13:45:42.095+09:00" level=info depth=2 ... msg="..."
+//
+// No dependency on spdlog or the depthlog headers.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace depthlog_tools {
+
+// Whole file mapped read-only. Empty files map to an empty view.
+class mapped_file {
+public:
+  explicit mapped_file(const std::string &path) {
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0)
+      throw std::runtime_error("cannot open " + path + ": " +
+                               std::strerror(errno));
+    struct stat st {};
+    if (::fstat(fd_, &st) != 0) {
+      ::close(fd_);
+      throw std::runtime_error("cannot stat " + path + ": " +
+                               std::strerror(errno));
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ == 0)
+      return;
+    void *p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd_);
+      throw std::runtime_error("cannot mmap " + path + ": " +
+                               std::strerror(errno));
+    }
+    data_ = static_cast<const char *>(p);
+    ::madvise(p, size_, MADV_SEQUENTIAL);
+  }
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+  mapped_file(mapped_file &&o) noexcept
+      : fd_(o.fd_), data_(o.data_), size_(o.size_) {
+    o.fd_ = -1;
+    o.data_ = nullptr;
+    o.size_ = 0;
+  }
+  ~mapped_file() {
+    if (data_)
+      ::munmap(const_cast<char *>(data_), size_);
+    if (fd_ >= 0)
+      ::close(fd_);
+  }
+
+  // The contents, less any NUL padding at the end (the partial last block
+  // of a log written with io_policy::direct, still open or not closed
+  // cleanly).
+  std::string_view view() const noexcept {
+    std::size_t n = size_;
+    while (n > 0 && data_[n - 1] == '\0')
+      --n;
+    return {data_, n};
+  }
+
+  // Drop pages behind a sequential reader from the page cache.
+  void release_before(std::size_t offset) const noexcept {
+    const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    const std::size_t end = offset / page * page;
+    if (data_ && end > 0)
+      ::madvise(const_cast<char *>(data_), end, MADV_DONTNEED);
+  }
+
+private:
+  int fd_ = -1;
+  const char *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+// Days since 1970-01-01 for a proleptic Gregorian date.
+inline std::int64_t days_from_civil(std::int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+}
+
+// "YYYY-MM-DDTHH:MM:SS[.fff...][Z|+HH:MM|-HH:MM]" -> ns since the epoch
+// (UTC). No allocation, no locale.
+inline bool parse_ts(std::string_view v, std::int64_t &out) noexcept {
+  std::size_t i = 0;
+  const auto num = [&](std::size_t digits, int &dst) {
+    if (i + digits > v.size())
+      return false;
+    int n = 0;
+    for (std::size_t k = 0; k < digits; ++k) {
+      const char c = v[i + k];
+      if (c < '0' || c > '9')
+        return false;
+      n = n * 10 + (c - '0');
+    }
+    i += digits;
+    dst = n;
+    return true;
+  };
+  const auto sep = [&](char c) {
+    return i < v.size() && v[i++] == c;
+  };
+  int y, mo, d, h, mi, s;
+  if (!num(4, y) || !sep('-') || !num(2, mo) || !sep('-') || !num(2, d) ||
+      !sep('T') || !num(2, h) || !sep(':') || !num(2, mi) || !sep(':') ||
+      !num(2, s))
+    return false;
+  std::int64_t frac = 0;
+  if (i < v.size() && v[i] == '.') {
+    ++i;
+    std::int64_t scale = 100000000;
+    while (i < v.size() && v[i] >= '0' && v[i] <= '9') {
+      frac += (v[i] - '0') * scale;
+      scale /= 10;
+      ++i;
+    }
+  }
+  std::int64_t secs =
+      days_from_civil(y, static_cast<unsigned>(mo), static_cast<unsigned>(d)) *
+          86400 +
+      h * 3600 + mi * 60 + s;
+  if (i < v.size() && (v[i] == '+' || v[i] == '-')) {
+    const int sign = v[i++] == '-' ? -1 : 1;
+    int oh, om = 0;
+    if (!num(2, oh))
+      return false;
+    if (i < v.size() && v[i] == ':')
+      ++i;
+    num(2, om);
+    secs -= sign * (oh * 3600 + om * 60);
+  }
+  out = secs * 1000000000 + frac;
+  return true;
+}
+
+// Decimal digits prefix of v (0 if none).
+inline std::uint64_t parse_u64(std::string_view v) noexcept {
+  std::uint64_t n = 0;
+  for (char c : v) {
+    if (c < '0' || c > '9')
+      break;
+    n = n * 10 + static_cast<std::uint64_t>(c - '0');
+  }
+  return n;
+}
+
+// Visits the key/value pairs of one line. Values are bare or quoted; msg is
+// always last and runs to the final quote, since the pattern does not
+// escape it. f returns false to stop early.
+template <class F> void for_each_field(std::string_view line, F &&f) {
+  std::size_t i = 0;
+  while (i < line.size()) {
+    while (i < line.size() && line[i] == ' ')
+      ++i;
+    const auto eq = line.find('=', i);
+    if (eq == std::string_view::npos)
+      return;
+    const auto key = line.substr(i, eq - i);
+    i = eq + 1;
+    std::string_view value;
+    if (i < line.size() && line[i] == '"') {
+      std::size_t end;
+      if (key == "msg") {
+        end = line.rfind('"');
+        if (end <= i)
+          end = line.size();
+      } else {
+        end = line.find('"', i + 1);
+        if (end == std::string_view::npos)
+          end = line.size();
+      }
+      value = line.substr(i + 1, end - i - 1);
+      i = end + 1;
+    } else {
+      const auto end = std::min(line.find(' ', i), line.size());
+      value = line.substr(i, end - i);
+      i = end;
+    }
+    if (!f(key, value))
+      return;
+  }
+}
+
+// Value of the first `key=` on the line; false if absent.
+inline bool find_field(std::string_view line, std::string_view key,
+                       std::string_view &value) {
+  bool found = false;
+  for_each_field(line, [&](std::string_view k, std::string_view v) {
+    if (k != key)
+      return true;
+    value = v;
+    found = true;
+    return false;
+  });
+  return found;
+}
+
+// Splits a buffer into lines (without the '\n').
+class line_reader {
+public:
+  explicit line_reader(std::string_view buf) : buf_(buf) {}
+
+  bool next(std::string_view &line) noexcept {
+    if (pos_ >= buf_.size())
+      return false;
+    const auto nl = buf_.find('\n', pos_);
+    const auto end = nl == std::string_view::npos ? buf_.size() : nl;
+    line = buf_.substr(pos_, end - pos_);
+    pos_ = end + 1;
+    return true;
+  }
+
+  std::size_t offset() const noexcept { return pos_; }
+
+private:
+  std::string_view buf_;
+  std::size_t pos_ = 0;
+};
+
+} // namespace depthlog_tools
@@ -0,0 +1,210 @@
+// tools/merge.cpp
+//
+// Streaming k-way merge of depthlog logfmt files (per-thread shards from
+// options::shard_per_thread, or logs of several processes) into one stream
+// ordered by timestamp, ready for depthlog_tree.py:
+//
+//   depthlog_merge [-o merged.log] a.log b.log ...
+//
+// Each input must already be in timestamp order, which holds for any
+// single depthlog file. Inputs are mmap'd and read front to back; pages
+// already merged are dropped, so memory stays bounded by the output buffer
+// plus one page per input. A loser tree picks the next record in
+// O(log k) comparisons.
+//
+// Order: ts (converted to UTC), then seq (%Q, see depthlog::next_seq();
+// exact across threads once seq epochs are in use), then input position on
+// the command line, then file order. Lines without a ts= field (e.g.
+// wrapped messages) keep the key of the record before them; records
+// without seq= sort as seq 0.
+
+#include "logfmt.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+struct input {
+  depthlog_tools::mapped_file file;
+  depthlog_tools::line_reader reader;
+  std::string_view line;
+  std::int64_t ts = INT64_MIN;
+  std::uint64_t seq = 0;
+  bool done = false;
+  std::size_t released = 0;
+
+  explicit input(const std::string &path)
+      : file(path), reader(file.view()) {}
+
+  void advance() {
+    if (!reader.next(line)) {
+      done = true;
+      return;
+    }
+    bool have_ts = false;
+    std::uint64_t s = 0;
+    depthlog_tools::for_each_field(
+        line, [&](std::string_view k, std::string_view v) {
+          if (k == "ts") {
+            std::int64_t t;
+            have_ts = depthlog_tools::parse_ts(v, t);
+            if (have_ts)
+              ts = t;
+          } else if (k == "seq") {
+            s = depthlog_tools::parse_u64(v);
+            return false; // ts comes first in every depthlog pattern
+          }
+          return true;
+        });
+    if (have_ts)
+      seq = s;
+    // Hand merged pages back every 16 MiB.
+    if (reader.offset() - released >= (std::size_t{16} << 20)) {
+      file.release_before(reader.offset());
+      released = reader.offset();
+    }
+  }
+};
+
+// Tournament tree of losers over k inputs: node n < k holds the loser of
+// the match between its children (2n, 2n+1; positions >= k are the
+// inputs), winner_ the overall winner.
+class loser_tree {
+public:
+  explicit loser_tree(std::vector<input> &in)
+      : in_(in), k_(in.size()), loser_(k_, 0) {
+    if (k_ == 0)
+      return;
+    std::vector<std::size_t> win(2 * k_);
+    for (std::size_t i = 0; i < k_; ++i)
+      win[k_ + i] = i;
+    for (std::size_t n = k_ - 1; n >= 1; --n) {
+      const auto a = win[2 * n], b = win[2 * n + 1];
+      win[n] = less_(b, a) ? b : a;
+      loser_[n] = win[n] == a ? b : a;
+    }
+    winner_ = k_ == 1 ? 0 : win[1];
+  }
+
+  bool empty() const { return k_ == 0 || in_[winner_].done; }
+  input &top() { return in_[winner_]; }
+
+  // Call after top() advanced.
+  void replay() {
+    auto w = winner_;
+    for (auto n = (w + k_) / 2; n >= 1; n /= 2) {
+      if (less_(loser_[n], w))
+        std::swap(loser_[n], w);
+    }
+    winner_ = w;
+  }
+
+private:
+  bool less_(std::size_t a, std::size_t b) const {
+    const input &x = in_[a], &y = in_[b];
+    if (x.done || y.done)
+      return !x.done;
+    if (x.ts != y.ts)
+      return x.ts < y.ts;
+    if (x.seq != y.seq)
+      return x.seq < y.seq;
+    return a < b;
+  }
+
+  std::vector<input> &in_;
+  std::size_t k_;
+  std::vector<std::size_t> loser_;
+  std::size_t winner_ = 0;
+};
+
+class output {
+public:
+  explicit output(std::FILE *f) : f_(f) { buf_.reserve(kSize); }
+  ~output() { flush(); }
+
+  void line(std::string_view l) {
+    if (buf_.size() + l.size() + 1 > kSize)
+      flush();
+    buf_.append(l.data(), l.size());
+    buf_.push_back('\n');
+  }
+
+  void flush() {
+    if (!buf_.empty() && std::fwrite(buf_.data(), 1, buf_.size(), f_) !=
+                             buf_.size())
+      ok_ = false;
+    buf_.clear();
+  }
+
+  bool ok() const { return ok_; }
+
+private:
+  static constexpr std::size_t kSize = std::size_t{1} << 20;
+  std::FILE *f_;
+  std::string buf_;
+  bool ok_ = true;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string out_path;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "-o") && i + 1 < argc)
+      out_path = argv[++i];
+    else if (!std::strncmp(argv[i], "-o", 2) && argv[i][2])
+      out_path = argv[i] + 2;
+    else
+      paths.emplace_back(argv[i]);
+  }
+  if (paths.empty()) {
+    std::fprintf(stderr, "usage: %s [-o merged.log] file.log...\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<input> inputs;
+  inputs.reserve(paths.size());
+  try {
+    for (const auto &p : paths)
+      inputs.emplace_back(p);
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "depthlog_merge: %s\n", e.what());
+    return 1;
+  }
+  for (auto &in : inputs)
+    in.advance();
+
+  std::FILE *f = out_path.empty() ? stdout : std::fopen(out_path.c_str(), "w");
+  if (!f) {
+    std::fprintf(stderr, "depthlog_merge: cannot open %s\n",
+                 out_path.c_str());
+    return 1;
+  }
+  bool ok;
+  {
+    output out(f);
+    loser_tree tree(inputs);
+    while (!tree.empty()) {
+      input &in = tree.top();
+      out.line(in.line);
+      in.advance();
+      tree.replay();
+    }
+    out.flush();
+    ok = out.ok();
+  }
+  if (f != stdout)
+    ok = std::fclose(f) == 0 && ok;
+  else
+    ok = std::fflush(stdout) == 0 && ok;
+  if (!ok) {
+    std::fprintf(stderr, "depthlog_merge: write error\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,137 @@
+// tools/query.cpp
+//
+// grep for depthlog logs, e.g. every error at depth > 5 in handle_* during
+// one minute:
+//
+//   depthlog_query --min-level=error --min-depth=6 --func='handle_*'
+//                  --since=2026-01-05T13:45 --until=2026-01-05T13:46
+//                  app.log
+//
+// Options:
+//   --tid=N              --min-depth=N / --max-depth=N
+//   --level=a,b,...      exact levels   --min-level=L   at least L
+//   --func=GLOB          --file=GLOB    (fnmatch patterns)
+//   --since=TIME         --until=TIME   (ISO-8601; no zone = local time)
+//   --grep=TEXT          msg substring
+//   -j N                 scan threads (default: all cores)
+//   --count              print the number of matches only
+//   --no-index           ignore <log>.idx
+//   --stats              scanned/total bytes per file on stderr
+//
+// Matching lines are written to stdout in file order, files in argument
+// order. See query.hpp for the library API.
+
+#include "query.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char *opt(const char *arg, const char *name) {
+  const auto n = std::strlen(name);
+  return std::strncmp(arg, name, n) == 0 ? arg + n : nullptr;
+}
+
+[[noreturn]] void usage_error(const char *prog, const std::string &msg) {
+  std::fprintf(stderr, "%s: %s\n", prog, msg.c_str());
+  std::exit(2);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  depthlog_tools::query_spec spec;
+  depthlog_tools::run_options ropts;
+  bool count_only = false, show_stats = false;
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *a = argv[i];
+    const char *v;
+    if ((v = opt(a, "--tid="))) {
+      spec.tid = std::strtoull(v, nullptr, 10);
+    } else if ((v = opt(a, "--min-depth="))) {
+      spec.min_depth = std::atoi(v);
+    } else if ((v = opt(a, "--max-depth="))) {
+      spec.max_depth = std::atoi(v);
+    } else if ((v = opt(a, "--min-level="))) {
+      spec.min_level = depthlog_tools::parse_level(v);
+      if (spec.min_level < 0)
+        usage_error(argv[0], std::string("unknown level ") + v);
+    } else if ((v = opt(a, "--level="))) {
+      std::string_view rest(v);
+      while (!rest.empty()) {
+        const auto comma = rest.find(',');
+        const auto name = rest.substr(0, comma);
+        const int l = depthlog_tools::parse_level(name);
+        if (l < 0)
+          usage_error(argv[0], "unknown level " + std::string(name));
+        spec.level_mask |= 1u << l;
+        rest = comma == std::string_view::npos ? std::string_view{}
+                                               : rest.substr(comma + 1);
+      }
+    } else if ((v = opt(a, "--func="))) {
+      spec.func_glob = v;
+    } else if ((v = opt(a, "--file="))) {
+      spec.file_glob = v;
+    } else if ((v = opt(a, "--since="))) {
+      std::int64_t ns;
+      if (!depthlog_tools::parse_ts_arg(v, ns))
+        usage_error(argv[0], std::string("bad time ") + v);
+      spec.since_ns = ns;
+    } else if ((v = opt(a, "--until="))) {
+      std::int64_t ns;
+      if (!depthlog_tools::parse_ts_arg(v, ns))
+        usage_error(argv[0], std::string("bad time ") + v);
+      spec.until_ns = ns;
+    } else if ((v = opt(a, "--grep="))) {
+      spec.msg_contains = v;
+    } else if (!std::strcmp(a, "-j") && i + 1 < argc) {
+      ropts.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+    } else if ((v = opt(a, "-j"))) {
+      ropts.threads = static_cast<unsigned>(std::atoi(v));
+    } else if (!std::strcmp(a, "--count")) {
+      count_only = true;
+    } else if (!std::strcmp(a, "--no-index")) {
+      ropts.use_index = false;
+    } else if (!std::strcmp(a, "--stats")) {
+      show_stats = true;
+    } else if (a[0] == '-' && a[1]) {
+      usage_error(argv[0], std::string("unknown option ") + a);
+    } else {
+      files.emplace_back(a);
+    }
+  }
+  if (files.empty())
+    usage_error(argv[0], "no input files");
+
+  const depthlog_tools::compiled_query q(spec);
+  std::size_t total = 0;
+  int rc = 0;
+  for (const auto &path : files) {
+    try {
+      const auto st = depthlog_tools::run_query(
+          path, q, ropts, [&](std::string_view out) {
+            if (!count_only)
+              std::fwrite(out.data(), 1, out.size(), stdout);
+          });
+      total += st.matches;
+      if (show_stats)
+        std::fprintf(stderr, "%s: scanned %zu of %zu bytes, %zu matches\n",
+                     path.c_str(), st.bytes_scanned, st.bytes_total,
+                     st.matches);
+    } catch (const std::exception &e) {
+      std::fprintf(stderr, "depthlog_query: %s\n", e.what());
+      rc = 1;
+    }
+  }
+  if (count_only)
+    std::printf("%zu\n", total);
+  if (std::fflush(stdout) != 0)
+    rc = 1;
+  return rc != 0 ? rc : (total ? 0 : 1);
+}
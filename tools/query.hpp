@@ -0,0 +1,355 @@
+#pragma once
+
+// tools/query.hpp
+//
+// Filtering depthlog logfmt logs:
+//
+//   depthlog_tools::query_spec spec;
+//   spec.min_level = 4;                       // error and up
+//   spec.min_depth = 6;
+//   spec.func_glob = "handle_*";
+//   std::int64_t since;
+//   if (depthlog_tools::parse_ts_arg("2026-01-05T13:45", since))
+//     spec.since_ns = since;
+//   depthlog_tools::compiled_query q(spec);
+//   depthlog_tools::run_query("app.log", q, {}, [](std::string_view out) {
+//     fwrite(out.data(), 1, out.size(), stdout);
+//   });
+//
+// compiled_query turns the spec into a list of per-field checks, ordered
+// cheapest first. The integer and level checks run during a single pass
+// over the line's fields, so most lines are rejected after a field or two;
+// the globs, the time parse and the payload search only run after that
+// pass, on the lines that got through it. The same spec is pushed
+// down onto the sidecar index (tid bloom, time range, max depth, level
+// mask) to skip whole blocks. Ranges are scanned in parallel and results
+// are delivered in file order.
+
+#include "index.hpp"
+#include "logfmt.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <fnmatch.h>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace depthlog_tools {
+
+// spdlog level numbering: trace=0 ... critical=5, off=6.
+inline int parse_level(std::string_view v) {
+  static const char *const names[] = {"trace",   "debug", "info",
+                                      "warning", "error", "critical"};
+  if (v == "warn")
+    return 3;
+  if (v == "err")
+    return 4;
+  for (int i = 0; i < 6; ++i)
+    if (v == names[i])
+      return i;
+  return -1;
+}
+
+// Command-line time: "YYYY-MM-DDTHH:MM[:SS[.fff]]" with an optional
+// Z/+HH:MM suffix; without one it is local time.
+inline bool parse_ts_arg(std::string_view v, std::int64_t &out) {
+  std::string s(v);
+  if (s.size() >= 16 && (s.size() == 16 || s[16] != ':'))
+    s.insert(16, ":00"); // no seconds
+  const bool has_zone =
+      s.size() > 19 && s.find_first_of("Z+-", 19) != std::string::npos;
+  if (has_zone) {
+    if (s.back() == 'Z')
+      s.pop_back();
+    return parse_ts(s, out);
+  }
+  std::int64_t utc;
+  if (!parse_ts(s, utc))
+    return false;
+  // Interpret the wall-clock fields as local time.
+  const std::int64_t secs = utc / 1000000000;
+  std::time_t t = static_cast<std::time_t>(secs);
+  std::tm tm{};
+  gmtime_r(&t, &tm);
+  tm.tm_isdst = -1;
+  out = static_cast<std::int64_t>(std::mktime(&tm)) * 1000000000 +
+        (utc - secs * 1000000000);
+  return true;
+}
+
+struct query_spec {
+  std::optional<std::uint64_t> tid;
+  int min_depth = 0;
+  int max_depth = INT32_MAX;
+  int min_level = 0;       // spdlog level number
+  unsigned level_mask = 0; // if non-zero: exact set of levels (bit n)
+  std::string func_glob;   // fnmatch(3) patterns; empty = any
+  std::string file_glob;
+  std::optional<std::int64_t> since_ns;
+  std::optional<std::int64_t> until_ns;
+  std::string msg_contains;
+};
+
+class compiled_query {
+public:
+  explicit compiled_query(query_spec spec) : spec_(std::move(spec)) {
+    levels_ = spec_.level_mask ? spec_.level_mask : 0x3fu;
+    levels_ &= ~((1u << spec_.min_level) - 1);
+    // Cheap integer checks first (run as their fields go by), then globs,
+    // then the time parse, then the payload search (deferred to the end
+    // of the line, as ts comes first in it).
+    if (spec_.tid)
+      checks_.push_back({"tid", &compiled_query::check_tid_, false});
+    if (spec_.min_depth > 0 || spec_.max_depth != INT32_MAX)
+      checks_.push_back({"depth", &compiled_query::check_depth_, false});
+    if (levels_ != 0x3fu)
+      checks_.push_back({"level", &compiled_query::check_level_, false});
+    if (!spec_.func_glob.empty())
+      checks_.push_back({"func", &compiled_query::check_func_, true});
+    if (!spec_.file_glob.empty())
+      checks_.push_back({"file", &compiled_query::check_file_, true});
+    if (spec_.since_ns || spec_.until_ns)
+      checks_.push_back({"ts", &compiled_query::check_ts_, true});
+    if (!spec_.msg_contains.empty())
+      checks_.push_back({"msg", &compiled_query::check_msg_, true});
+    func_literal_ = !has_glob_chars_(spec_.func_glob);
+    file_literal_ = !has_glob_chars_(spec_.file_glob);
+  }
+
+  const query_spec &spec() const { return spec_; }
+
+  // Line-level evaluation. Every check must see its field; a line missing
+  // a constrained field does not match.
+  bool match(std::string_view line) const {
+    if (checks_.empty())
+      return true;
+    // Bit i set once checks_[i] passed, or its value was kept for later.
+    std::uint32_t seen = 0;
+    const std::uint32_t all = (std::uint32_t{1} << checks_.size()) - 1;
+    std::array<std::string_view, kMaxChecks> deferred;
+    bool failed = false;
+    for_each_field(line, [&](std::string_view k, std::string_view v) {
+      for (std::size_t i = 0; i < checks_.size(); ++i) {
+        if (k != checks_[i].field)
+          continue;
+        if (checks_[i].deferred)
+          deferred[i] = v;
+        else if (!(this->*checks_[i].fn)(v)) {
+          failed = true;
+          return false;
+        }
+        seen |= std::uint32_t{1} << i;
+        return seen != all;
+      }
+      return true;
+    });
+    if (failed || seen != all)
+      return false;
+    for (std::size_t i = 0; i < checks_.size(); ++i)
+      if (checks_[i].deferred && !(this->*checks_[i].fn)(deferred[i]))
+        return false;
+    return true;
+  }
+
+  // Block-level pushdown onto the sidecar index.
+  bool may_match(const index_entry &e) const {
+    using depthlog::index_format::bloom_may_contain;
+    if (spec_.tid && !bloom_may_contain(e, *spec_.tid))
+      return false;
+    if (e.max_depth < spec_.min_depth)
+      return false;
+    if ((e.level_mask & levels_) == 0)
+      return false;
+    if (spec_.since_ns && e.last_ts_ns < *spec_.since_ns)
+      return false;
+    // Printed timestamps are truncated, so compare at whole seconds.
+    if (spec_.until_ns &&
+        e.first_ts_ns / 1000000000 * 1000000000 > *spec_.until_ns)
+      return false;
+    return true;
+  }
+
+private:
+  using check_fn = bool (compiled_query::*)(std::string_view) const;
+  struct check {
+    std::string_view field;
+    check_fn fn;
+    bool deferred; // run after the field pass, in checks_ order
+  };
+  static constexpr std::size_t kMaxChecks = 7;
+
+  static bool has_glob_chars_(const std::string &g) {
+    return g.find_first_of("*?[") != std::string::npos;
+  }
+
+  static bool glob_(const std::string &pattern, bool literal,
+                    std::string_view v) {
+    if (literal)
+      return v == pattern;
+    const std::string s(v);
+    return ::fnmatch(pattern.c_str(), s.c_str(), 0) == 0;
+  }
+
+  bool check_tid_(std::string_view v) const {
+    return parse_u64(v) == *spec_.tid;
+  }
+  bool check_depth_(std::string_view v) const {
+    const auto d = static_cast<std::int64_t>(parse_u64(v));
+    return d >= spec_.min_depth && d <= spec_.max_depth;
+  }
+  bool check_level_(std::string_view v) const {
+    const int l = parse_level(v);
+    return l >= 0 && (levels_ >> l & 1);
+  }
+  bool check_func_(std::string_view v) const {
+    return glob_(spec_.func_glob, func_literal_, v);
+  }
+  bool check_file_(std::string_view v) const {
+    return glob_(spec_.file_glob, file_literal_, v);
+  }
+  bool check_ts_(std::string_view v) const {
+    std::int64_t ts;
+    if (!parse_ts(v, ts))
+      return false;
+    return (!spec_.since_ns || ts >= *spec_.since_ns) &&
+           (!spec_.until_ns || ts <= *spec_.until_ns);
+  }
+  bool check_msg_(std::string_view v) const {
+    return v.find(spec_.msg_contains) != std::string_view::npos;
+  }
+
+  query_spec spec_;
+  unsigned levels_;
+  bool func_literal_ = true;
+  bool file_literal_ = true;
+  std::vector<check> checks_;
+};
+
+struct run_options {
+  unsigned threads = 0; // 0 = hardware_concurrency
+  bool use_index = true;
+  std::size_t chunk_bytes = 4u << 20;
+};
+
+struct run_stats {
+  std::size_t bytes_total = 0;
+  std::size_t bytes_scanned = 0;
+  std::size_t matches = 0;
+};
+
+// Scans one log file; out(std::string_view) receives the matching lines
+// (with '\n') chunk by chunk, in file order, on the calling thread. At most
+// 2 * threads chunks of results are buffered.
+template <class Out>
+run_stats run_query(const std::string &path, const compiled_query &q,
+                    const run_options &opts, Out &&out) {
+  const mapped_file file(path);
+  const auto log = file.view();
+  run_stats stats;
+  stats.bytes_total = log.size();
+
+  std::vector<index_entry> index;
+  if (opts.use_index)
+    index = read_index(path, log.size());
+  const auto ranges = plan_ranges(
+      log, index, [&](const index_entry &e) { return q.may_match(e); },
+      opts.chunk_bytes);
+  for (const auto &r : ranges)
+    stats.bytes_scanned += r.end - r.begin;
+
+  unsigned n = opts.threads ? opts.threads
+                            : std::max(1u, std::thread::hardware_concurrency());
+  n = static_cast<unsigned>(
+      std::min<std::size_t>(n, std::max<std::size_t>(1, ranges.size())));
+  const std::size_t window = 2 * static_cast<std::size_t>(n);
+
+  struct slot {
+    std::string text;
+    std::size_t matches = 0;
+    bool ready = false;
+  };
+  const auto scan = [&](std::size_t i) {
+    slot s;
+    line_reader reader(
+        log.substr(ranges[i].begin, ranges[i].end - ranges[i].begin));
+    std::string_view line;
+    while (reader.next(line)) {
+      if (q.match(line)) {
+        s.text.append(line.data(), line.size());
+        s.text.push_back('\n');
+        ++s.matches;
+      }
+    }
+    return s;
+  };
+
+  if (n == 1) {
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+      const slot s = scan(i);
+      stats.matches += s.matches;
+      if (!s.text.empty())
+        out(std::string_view(s.text));
+    }
+    return stats;
+  }
+
+  std::vector<slot> results(ranges.size());
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::size_t emitted = 0; // guarded by mutex
+  std::atomic<std::size_t> next{0};
+
+  const auto worker = [&] {
+    for (;;) {
+      const auto i = next.fetch_add(1, std::memory_order_relaxed);
+      if (i >= ranges.size())
+        return;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return i < emitted + window; });
+      }
+      slot s = scan(i);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        results[i] = std::move(s);
+        results[i].ready = true;
+      }
+      cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < n; ++t)
+    pool.emplace_back(worker);
+
+  // The calling thread only writes, in order.
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    std::string text;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&] { return results[i].ready; });
+      text = std::move(results[i].text);
+      stats.matches += results[i].matches;
+      results[i].text = std::string();
+    }
+    if (!text.empty())
+      out(std::string_view(text));
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      ++emitted;
+    }
+    cv.notify_all();
+  }
+  for (auto &t : pool)
+    t.join();
+  return stats;
+}
+
+} // namespace depthlog_tools